@@ -0,0 +1,117 @@
+// Connection handling end to end on one loop: a client coroutine writes
+// requests over a socketpair, the Connection parses and forwards them
+// through a real Bridge to the stub worker (stub_worker.hpp), and relays
+// the responses back.
+
+#ifndef _WIN32
+
+#include "stub_worker.hpp"
+#include "asgi/bridge.hpp"
+#include "core/event_loop.hpp"
+#include "core/socket.hpp"
+#include "http/connection.hpp"
+#include <benchmark/benchmark.h>
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace cppcorn::http {
+    thread_local asgi::Bridge* g_bridge = nullptr;
+}
+
+using namespace cppcorn;
+
+namespace {
+
+const std::string REQUEST =
+    "GET /items/42?q=search HTTP/1.1\r\n"
+    "Host: localhost:8000\r\n"
+    "User-Agent: bench\r\n"
+    "Accept: */*\r\n"
+    "\r\n";
+
+// One bridge and stub worker for the whole run, on the benchmark thread
+asgi::Bridge& stub_bridge() {
+    static asgi::Bridge* bridge = [] {
+        char self[PATH_MAX];
+        ssize_t n = ::readlink("/proc/self/exe", self, sizeof(self) - 1);
+        if (n <= 0) throw std::runtime_error("Cannot find the benchmark binary");
+        asgi::WorkerConfig config;
+        config.count = 1;
+        config.python = std::string(self, (size_t)n);
+        config.script = STUB_WORKER_ARG;
+        config.transport = asgi::IpcTransport::Unix;
+        auto* b = new asgi::Bridge(config); // Lives until exit, as in the server
+        b->start();
+        return b;
+    }();
+    return *bridge;
+}
+
+core::Task<bool> read_exactly(core::Socket& sock, std::vector<char>& buf, size_t total) {
+    size_t got = 0;
+    while (got < total) {
+        size_t n = co_await sock.read(std::span(buf.data(), std::min(buf.size(), total - got)));
+        if (n == 0) co_return false;
+        got += n;
+    }
+    co_return true;
+}
+
+// Measures one response first (its size is fixed: Date has a fixed width),
+// then sends `depth` requests per iteration and reads their responses
+core::FireAndForget client(benchmark::State& state, core::Socket& sock, int depth) {
+    std::vector<char> buf(64 * 1024);
+    std::string batch;
+    for (int i = 0; i < depth; ++i) batch += REQUEST;
+
+    size_t response_size = 0;
+    co_await sock.write(std::span<const char>(REQUEST));
+    while (true) {
+        size_t n = co_await sock.read(std::span(buf));
+        if (n == 0) break;
+        response_size += n;
+        std::string_view seen(buf.data(), response_size);
+        if (seen.size() >= std::strlen(STUB_BODY) && seen.ends_with(STUB_BODY)) break;
+    }
+
+    if (response_size == 0) {
+        state.SkipWithError("No response from the connection");
+    } else {
+        for (auto _ : state) {
+            co_await sock.write(std::span<const char>(batch));
+            if (!co_await read_exactly(sock, buf, response_size * depth)) {
+                state.SkipWithError("Connection closed");
+                break;
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * depth);
+
+    // The connection deletes itself on EOF; then the run ends
+    sock.shutdown();
+    co_await sock.read(std::span(buf));
+    core::EventLoop::instance().stop();
+}
+
+void BM_ConnectionRequest(benchmark::State& state) {
+    http::g_bridge = &stub_bridge();
+
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) throw std::runtime_error("socketpair");
+    core::Socket client_sock(fds[0]);
+    client_sock.set_non_blocking();
+
+    auto* conn = new http::Connection(core::Socket(fds[1]));
+    conn->start(); // Self-deleting
+    client(state, client_sock, (int)state.range(0));
+    core::EventLoop::instance().run();
+}
+BENCHMARK(BM_ConnectionRequest)->ArgName("depth")->Arg(1)->Arg(16)->UseRealTime();
+
+} // namespace
+
+#endif
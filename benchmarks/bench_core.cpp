@@ -0,0 +1,92 @@
+// Coroutine and event loop costs: creating and awaiting Task<T>, and a
+// wakeup round trip through the loop over a socketpair.
+
+#include "core/coroutine.hpp"
+#include "core/event_loop.hpp"
+#include "core/socket.hpp"
+#include <benchmark/benchmark.h>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
+using namespace cppcorn::core;
+
+namespace {
+
+Task<int> leaf(int v) {
+    co_return v + 1;
+}
+
+Task<int> chain(int depth, int v) {
+    if (depth == 0) co_return co_await leaf(v);
+    co_return co_await chain(depth - 1, v);
+}
+
+// FireAndForget starts eagerly; nothing here suspends, so the whole
+// benchmark loop runs inside it
+FireAndForget await_leaf(benchmark::State& state) {
+    int v = 0;
+    for (auto _ : state) {
+        v = co_await leaf(v);
+        benchmark::DoNotOptimize(v);
+    }
+}
+
+FireAndForget await_chain(benchmark::State& state, int depth) {
+    int v = 0;
+    for (auto _ : state) {
+        v = co_await chain(depth, v);
+        benchmark::DoNotOptimize(v);
+    }
+}
+
+void BM_TaskCreateAwait(benchmark::State& state) {
+    await_leaf(state);
+}
+BENCHMARK(BM_TaskCreateAwait);
+
+// Frames per iteration: depth + 1
+void BM_TaskChain(benchmark::State& state) {
+    await_chain(state, (int)state.range(0));
+    state.SetItemsProcessed(state.iterations() * (state.range(0) + 1));
+}
+BENCHMARK(BM_TaskChain)->Arg(4)->Arg(16);
+
+#ifndef _WIN32
+// Echoes until the peer shuts down, then ends the run
+FireAndForget echo(Socket& sock) {
+    char byte;
+    while (co_await sock.read(std::span(&byte, 1)) == 1) {
+        co_await sock.write(std::span<const char>(&byte, 1));
+    }
+    EventLoop::instance().stop();
+}
+
+FireAndForget ping(benchmark::State& state, Socket& sock) {
+    char byte = 'x';
+    for (auto _ : state) {
+        co_await sock.write(std::span<const char>(&byte, 1));
+        co_await sock.read(std::span(&byte, 1));
+    }
+    sock.shutdown();
+}
+
+// One iteration: two coroutines on the loop exchange a byte each way, so
+// each side is parked and woken by the loop once
+void BM_LoopWakeup(benchmark::State& state) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) throw std::runtime_error("socketpair");
+    Socket a(fds[0]), b(fds[1]);
+    a.set_non_blocking();
+    b.set_non_blocking();
+
+    echo(b);
+    ping(state, a);
+    EventLoop::instance().run();
+}
+BENCHMARK(BM_LoopWakeup)->UseRealTime();
+#endif
+
+} // namespace
@@ -0,0 +1,108 @@
+// Bridge framing: encoding request frames and decoding the worker's
+// response frames.
+
+#include "asgi/protocol.hpp"
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace cppcorn::asgi;
+
+namespace {
+
+const std::pair<std::string_view, std::string_view> HEADERS[] = {
+    {"Host", "localhost:8000"},
+    {"User-Agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36"},
+    {"Accept", "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8"},
+    {"Accept-Encoding", "gzip, deflate, br"},
+    {"Accept-Language", "en-GB,en;q=0.9"},
+    {"Connection", "keep-alive"},
+    {"Cookie", "session=7f3a9c2e4b1d8f6a0e5c3b2a1d9f8e7c; theme=dark"},
+    {"Cache-Control", "no-cache"},
+};
+
+// Builds a frame as the worker does (protocol.hpp describes the layout)
+void put_frame(std::vector<char>& out, MessageType type, uint32_t id, std::string_view payload) {
+    uint32_t len = (uint32_t)(1 + sizeof(uint32_t) + payload.size());
+    out.insert(out.end(), (const char*)&len, (const char*)&len + sizeof(len));
+    out.push_back((char)type);
+    out.insert(out.end(), (const char*)&id, (const char*)&id + sizeof(id));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+std::string response_start_payload() {
+    std::string p;
+    auto put16 = [&](uint16_t v) { p.append((const char*)&v, sizeof(v)); };
+    auto put32 = [&](uint32_t v) { p.append((const char*)&v, sizeof(v)); };
+    put16(200);
+    put16(2);
+    for (auto [name, value] : {std::pair<std::string_view, std::string_view>{"content-type", "application/json"},
+                               {"cache-control", "public, max-age=60"}}) {
+        put16((uint16_t)name.size());
+        p += name;
+        put32((uint32_t)value.size());
+        p += value;
+    }
+    return p;
+}
+
+void BM_EncodeRequest(benchmark::State& state) {
+    HttpScope scope{"GET", "/items/42?q=search", HEADERS, {}, false};
+    std::vector<char> out;
+    uint32_t id = 1;
+    for (auto _ : state) {
+        out.clear();
+        Protocol::encode_request_into(out, scope, id++);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed((int64_t)(state.iterations() * out.size()));
+}
+BENCHMARK(BM_EncodeRequest);
+
+void BM_EncodeBody(benchmark::State& state) {
+    std::string body((size_t)state.range(0), 'x');
+    std::vector<char> out;
+    for (auto _ : state) {
+        out.clear();
+        Protocol::encode_body_into(out, body, true, 1);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed((int64_t)(state.iterations() * body.size()));
+}
+BENCHMARK(BM_EncodeBody)->Arg(1024)->Arg(64 * 1024);
+
+// A read's worth of responses: start + body frames for 32 requests
+void BM_TryDecode(benchmark::State& state) {
+    std::vector<char> buffer;
+    std::string start = response_start_payload();
+    std::string body = std::string(1, '\0') + R"({"item_id":42,"name":"widget","price":9.99})";
+    for (uint32_t id = 1; id <= 32; ++id) {
+        put_frame(buffer, MessageType::HTTP_RESPONSE_START, id, start);
+        put_frame(buffer, MessageType::HTTP_RESPONSE_BODY, id, body);
+    }
+
+    HttpResponse response;
+    size_t frames = 0;
+    for (auto _ : state) {
+        std::span<const char> rest(buffer);
+        Message msg;
+        while (size_t n = Protocol::try_decode(rest, msg)) {
+            if (msg.type == MessageType::HTTP_RESPONSE_START) {
+                Protocol::decode_response_start(msg.payload, response);
+            } else {
+                std::string_view chunk;
+                benchmark::DoNotOptimize(Protocol::decode_response_body(msg.payload, chunk));
+            }
+            rest = rest.subspan(n);
+            ++frames;
+        }
+    }
+    state.SetItemsProcessed((int64_t)frames);
+    state.SetBytesProcessed((int64_t)(state.iterations() * buffer.size()));
+}
+BENCHMARK(BM_TryDecode);
+
+} // namespace
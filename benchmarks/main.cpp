@@ -0,0 +1,15 @@
+#include "stub_worker.hpp"
+#include <benchmark/benchmark.h>
+#include <cstring>
+
+int main(int argc, char** argv) {
+#ifndef _WIN32
+    // Spawned by the bridge in bench_connection.cpp
+    if (argc > 1 && std::strcmp(argv[1], STUB_WORKER_ARG) == 0) return run_stub_worker();
+#endif
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,93 @@
+#ifndef _WIN32
+
+#include "stub_worker.hpp"
+#include "asgi/protocol.hpp"
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace cppcorn::asgi;
+
+namespace {
+
+void put_frame(std::vector<char>& out, MessageType type, uint32_t id, std::string_view payload) {
+    uint32_t len = (uint32_t)(1 + sizeof(uint32_t) + payload.size());
+    out.insert(out.end(), (const char*)&len, (const char*)&len + sizeof(len));
+    out.push_back((char)type);
+    out.insert(out.end(), (const char*)&id, (const char*)&id + sizeof(id));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+std::string response_start() {
+    std::string p;
+    auto put16 = [&](uint16_t v) { p.append((const char*)&v, sizeof(v)); };
+    auto put32 = [&](uint32_t v) { p.append((const char*)&v, sizeof(v)); };
+    std::string_view name = "content-type", value = "text/plain";
+    put16(200);
+    put16(1);
+    put16((uint16_t)name.size());
+    p += name;
+    put32((uint32_t)value.size());
+    p += value;
+    return p;
+}
+
+int connect_bridge(std::string_view path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return -1;
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    if (path[0] == '@') addr.sun_path[0] = '\0'; // Abstract namespace
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    socklen_t len = offsetof(sockaddr_un, sun_path) + path.size();
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, len) != 0) return -1;
+    return fd;
+}
+
+} // namespace
+
+int run_stub_worker() {
+    const char* path = std::getenv("CPPCORN_IPC_PATH");
+    if (!path) return 1;
+    int fd = connect_bridge(path);
+    if (fd < 0) return 1;
+
+    std::string start = response_start();
+    std::string body = std::string(1, '\0') + STUB_BODY; // more_body = 0
+    std::vector<char> in, out;
+    char buf[65536];
+    while (true) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        in.insert(in.end(), buf, buf + n);
+
+        // Reply to every request in the read with one write
+        std::span<const char> rest(in);
+        Message msg;
+        while (size_t used = Protocol::try_decode(rest, msg)) {
+            if (msg.type == MessageType::HTTP_REQUEST) {
+                put_frame(out, MessageType::HTTP_RESPONSE_START, msg.request_id, start);
+                put_frame(out, MessageType::HTTP_RESPONSE_BODY, msg.request_id, body);
+            }
+            rest = rest.subspan(used);
+        }
+        in.erase(in.begin(), in.end() - rest.size());
+
+        for (size_t off = 0; off < out.size();) {
+            ssize_t w = ::write(fd, out.data() + off, out.size() - off);
+            if (w <= 0) return 0;
+            off += (size_t)w;
+        }
+        out.clear();
+    }
+    ::close(fd);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,10 @@
+#pragma once
+
+// Run with STUB_WORKER_ARG, the benchmark binary is a minimal worker: it
+// connects to the bridge named in CPPCORN_IPC_PATH and answers every request
+// with the same small response, so the server side can be measured without
+// Python in the way.
+inline constexpr const char* STUB_WORKER_ARG = "--stub-worker";
+inline constexpr const char* STUB_BODY = "Hello, world!";
+
+int run_stub_worker();
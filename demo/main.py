@@ -1,4 +1,4 @@
-from fastapi import FastAPI
+from fastapi import FastAPI, Response
 
 app = FastAPI()
 
@@ -7,5 +7,7 @@ async def root():
     return {"message": "Hello from FastAPI running on CppCorn!"}
 
 @app.get("/items/{item_id}")
-async def read_item(item_id: int):
+async def read_item(item_id: int, response: Response):
+    # Shared caches (e.g. CppCorn's, with CPPCORN_CACHE_MB set) may reuse this
+    response.headers["Cache-Control"] = "public, max-age=60"
     return {"item_id": item_id, "server": "cppcorn"}
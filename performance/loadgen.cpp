@@ -0,0 +1,644 @@
+// cppcorn-loadgen: HTTP/1.1 load generator on CppCorn's own EventLoop and
+// Socket. One loop per thread, keep-alive connections, optional pipelining.
+//
+// Closed loop (default): each connection keeps `pipeline` requests in flight.
+// Open loop (--rate): requests are sent on a fixed schedule whether or not
+// earlier ones have been answered, and latency is measured from the time a
+// request was due, not when it was sent, so a stalled server is charged for
+// the requests it held up (no coordinated omission).
+
+#ifdef _WIN32
+
+#include <cstdio>
+
+int main() {
+    std::fprintf(stderr, "cppcorn-loadgen is not supported on Windows\n");
+    return 1;
+}
+
+#else
+
+#include "core/event_loop.hpp"
+#include "core/socket.hpp"
+#include "core/timer.hpp"
+#include <llhttp.h>
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <coroutine>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+using namespace cppcorn::core;
+
+namespace {
+
+// Microsecond latencies with 64 linear sub-buckets per power of two
+// (under 1.6% error), up to 2^40 us
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 6;
+    static constexpr int SUB = 1 << SUB_BITS;
+    static constexpr int BUCKETS = (40 - SUB_BITS + 1) * SUB;
+
+    void record(uint64_t us) {
+        counts_[index(us)]++;
+        total_++;
+        sum_ += us;
+        min_ = std::min(min_, us);
+        max_ = std::max(max_, us);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < BUCKETS; ++i) counts_[i] += other.counts_[i];
+        total_ += other.total_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t min() const { return total_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_ ? (double)sum_ / total_ : 0; }
+
+    // Highest value in the bucket holding the q-th quantile
+    uint64_t percentile(double q) const {
+        if (total_ == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(q * total_));
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) return std::min(upper(i), max_);
+        }
+        return max_;
+    }
+
+private:
+    static int index(uint64_t v) {
+        if (v < SUB) return (int)v;
+        int shift = (int)std::bit_width(v) - 1 - SUB_BITS;
+        int i = (shift + 1) * SUB + (int)((v >> shift) - SUB);
+        return std::min(i, BUCKETS - 1);
+    }
+
+    static uint64_t upper(int i) {
+        if (i < SUB) return (uint64_t)i;
+        int shift = i / SUB - 1;
+        return (((uint64_t)(i % SUB + SUB) + 1) << shift) - 1;
+    }
+
+    std::array<uint64_t, BUCKETS> counts_{};
+    uint64_t total_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+};
+
+struct Config {
+    std::string url;
+    std::string host;
+    int port = 80;
+    std::string path = "/";
+    std::vector<std::string> headers;
+    int threads = 1;
+    int connections = 10;
+    int pipeline = 1;
+    double duration_s = 10;
+    double rate = 0; // Requests/s over all connections; 0 is closed loop
+    double timeout_s = 2; // Grace period for responses after the run
+    std::string json_path;
+
+    sockaddr_storage addr{};
+    socklen_t addr_len = 0;
+    std::string request;
+};
+
+struct Stats {
+    LatencyHistogram latency; // From the time the request was due
+    LatencyHistogram service; // From the time it was actually sent
+    std::array<uint64_t, 6> status{}; // By class: [1] = 1xx ... [5] = 5xx, [0] other
+    uint64_t bytes = 0;
+    uint64_t connect_errors = 0;
+    uint64_t read_errors = 0; // Requests lost to a closed connection or a bad response
+    uint64_t timeouts = 0; // Still unanswered at the end of the grace period
+    uint64_t unsent = 0; // Due in the open-loop schedule but never sent
+
+    void merge(const Stats& o) {
+        latency.merge(o.latency);
+        service.merge(o.service);
+        for (size_t i = 0; i < status.size(); ++i) status[i] += o.status[i];
+        bytes += o.bytes;
+        connect_errors += o.connect_errors;
+        read_errors += o.read_errors;
+        timeouts += o.timeouts;
+        unsent += o.unsent;
+    }
+};
+
+// One waiting coroutine, resumed by notify(). Callers check their condition
+// before awaiting; everything runs on one loop thread.
+struct Signal {
+    std::coroutine_handle<> waiter;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) { waiter = h; }
+    void await_resume() const noexcept {}
+
+    void notify() {
+        if (auto h = std::exchange(waiter, nullptr)) h.resume();
+    }
+};
+
+// timerfd with microsecond resolution; the wheel only ticks in milliseconds,
+// which would add up to 1 ms of lag to every open-loop send. Read through a
+// Socket: ReadOp is a plain read() under epoll.
+class PreciseTimer {
+public:
+    PreciseTimer() : fd_(create()) {}
+
+    // Fires `delay_us` from now (at least 1 us; 0 would disarm it)
+    void arm(uint64_t delay_us) {
+        delay_us = std::max<uint64_t>(delay_us, 1);
+        itimerspec spec{};
+        spec.it_value.tv_sec = (time_t)(delay_us / 1000000);
+        spec.it_value.tv_nsec = (long)(delay_us % 1000000) * 1000;
+        ::timerfd_settime(fd_.fd(), 0, &spec, nullptr);
+    }
+
+    Socket::ReadOp wait() { return fd_.read(std::span(expirations_, sizeof(expirations_))); }
+
+private:
+    static int create() {
+        int fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (fd < 0) throw std::runtime_error("timerfd_create failed");
+        return fd;
+    }
+
+    Socket fd_;
+    char expirations_[8];
+};
+
+class Client {
+public:
+    // `first_us` is this connection's first send in the open-loop schedule
+    Client(const Config& config, Stats& stats, uint64_t start_us, uint64_t end_us,
+           double interval_us, uint64_t first_us)
+        : config_(config), stats_(stats), start_us_(start_us), end_us_(end_us),
+          grace_end_us_(end_us + (uint64_t)(config.timeout_s * 1e6)), interval_us_(interval_us),
+          next_us_((double)first_us) {
+        for (int i = 0; i < config.pipeline; ++i) batch_ += config.request;
+        llhttp_settings_init(&settings_);
+        settings_.on_headers_complete = on_headers_complete;
+        settings_.on_message_complete = on_message_complete;
+    }
+
+    FireAndForget run(Signal& done, int& live);
+
+    // Past the grace period: drop whatever is still in flight
+    void abort() {
+        aborted_ = true;
+        if (sock_) sock_->shutdown();
+        timer_.arm(1);
+    }
+
+private:
+    struct Pending {
+        uint64_t due_us;
+        uint64_t sent_us;
+    };
+
+    bool open_loop() const { return interval_us_ > 0; }
+    bool connect();
+    // Writes the last `count` entries of pending_
+    Task<bool> write_requests(int count);
+    FireAndForget write_schedule();
+    // Returns early once `*cancel` is set (and the timer kicked)
+    Task<void> wait_until(uint64_t at_us, const bool* cancel);
+    void close_session();
+
+    static int on_headers_complete(llhttp_t* p);
+    static int on_message_complete(llhttp_t* p);
+
+    const Config& config_;
+    Stats& stats_;
+    uint64_t start_us_;
+    uint64_t end_us_;
+    uint64_t grace_end_us_; // Unanswered requests are charged up to here
+    double interval_us_;
+    double next_us_; // Next due time in the open-loop schedule
+
+    std::optional<Socket> sock_;
+    PreciseTimer timer_;
+    llhttp_t parser_;
+    llhttp_settings_t settings_;
+    std::string batch_; // `pipeline` copies of the request
+    std::deque<Pending> pending_;
+    int status_ = 0;
+
+    bool closed_ = false; // Current session is over
+    bool aborted_ = false;
+    bool writer_done_ = true;
+    Signal slot_; // Writer waits for a pipeline slot
+    Signal writer_exit_;
+};
+
+bool Client::connect() {
+    int fd = ::socket(config_.addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    Socket sock(fd);
+    // Blocking: done once per connection, before the run on a healthy server
+    if (::connect(fd, (const sockaddr*)&config_.addr, config_.addr_len) != 0) return false;
+    sock.set_non_blocking();
+    sock.set_no_delay();
+    sock_.emplace(std::move(sock));
+    llhttp_init(&parser_, HTTP_RESPONSE, &settings_);
+    parser_.data = this;
+    closed_ = false;
+    return true;
+}
+
+Task<void> Client::wait_until(uint64_t at_us, const bool* cancel) {
+    // A kick or a stale expiration can wake us early; check and re-arm
+    while (!*cancel) {
+        uint64_t now = EventLoop::monotonic_us();
+        if (at_us <= now) break;
+        timer_.arm(at_us - now);
+        co_await timer_.wait();
+    }
+}
+
+Task<bool> Client::write_requests(int count) {
+    size_t len = (size_t)count * config_.request.size();
+    co_return co_await sock_->write(std::span<const char>(batch_.data(), len)) == len;
+}
+
+// Open loop: sends every request as it falls due, up to `pipeline` in flight
+FireAndForget Client::write_schedule() {
+    writer_done_ = false;
+    while (!closed_ && next_us_ < (double)end_us_) {
+        co_await wait_until((uint64_t)next_us_, &closed_);
+        if (closed_) break;
+
+        // Everything due by now goes out in one write, each with its own due time
+        uint64_t now = EventLoop::monotonic_us();
+        int count = 0;
+        while (next_us_ <= (double)now && next_us_ < (double)end_us_ &&
+               (int)pending_.size() < config_.pipeline) {
+            pending_.push_back({(uint64_t)next_us_, now});
+            next_us_ += interval_us_;
+            count++;
+        }
+        if (count > 0) {
+            if (!co_await write_requests(count)) break;
+        } else if ((int)pending_.size() >= config_.pipeline) {
+            co_await slot_;
+        }
+    }
+    // Nothing left to wait for: let the reader see EOF
+    if (!closed_ && pending_.empty()) sock_->shutdown();
+    writer_done_ = true;
+    writer_exit_.notify();
+}
+
+void Client::close_session() {
+    closed_ = true;
+    if (aborted_) {
+        // Never answered: at least the grace period late
+        for (const Pending& req : pending_) stats_.latency.record(grace_end_us_ - req.due_us);
+    }
+    (aborted_ ? stats_.timeouts : stats_.read_errors) += pending_.size();
+    pending_.clear();
+    slot_.notify();
+    timer_.arm(1); // Wakes a writer parked on the schedule
+}
+
+FireAndForget Client::run(Signal& done, int& live) {
+    std::vector<char> buf(64 * 1024);
+
+    while (!aborted_ && EventLoop::monotonic_us() < end_us_) {
+        if (!connect()) {
+            stats_.connect_errors++;
+            co_await wait_until(EventLoop::monotonic_us() + 100000, &aborted_);
+            continue;
+        }
+        co_await wait_until(start_us_, &aborted_); // Only the first time
+        if (open_loop()) write_schedule();
+
+        bool failed = false;
+        while (true) {
+            // Closed loop: top the pipeline back up until the run ends
+            if (!open_loop() && EventLoop::monotonic_us() < end_us_) {
+                int room = config_.pipeline - (int)pending_.size();
+                uint64_t now = EventLoop::monotonic_us();
+                for (int i = 0; i < room; ++i) pending_.push_back({now, now});
+                if (room > 0 && !co_await write_requests(room)) break;
+            }
+            if (pending_.empty() && (!open_loop() || writer_done_)) break;
+
+            size_t n = co_await sock_->read(std::span(buf));
+            if (n == 0) break;
+            stats_.bytes += n;
+            bool was_full = (int)pending_.size() >= config_.pipeline;
+            if (llhttp_execute(&parser_, buf.data(), n) != HPE_OK) {
+                failed = true;
+                break;
+            }
+            if (was_full && (int)pending_.size() < config_.pipeline) slot_.notify();
+        }
+        if (failed) {
+            stats_.read_errors++; // The response that didn't parse
+            if (!pending_.empty()) pending_.pop_front();
+        }
+        close_session();
+        if (!writer_done_) co_await writer_exit_;
+        sock_.reset();
+    }
+
+    // Due before the end but never sent (the connection couldn't keep up).
+    // They still count in the latency, as answered at the end of the grace
+    // period, or the percentiles would omit the worst of a stall.
+    while (open_loop() && next_us_ < (double)end_us_) {
+        stats_.latency.record(grace_end_us_ - (uint64_t)next_us_);
+        stats_.unsent++;
+        next_us_ += interval_us_;
+    }
+    if (--live == 0) done.notify();
+}
+
+int Client::on_headers_complete(llhttp_t* p) {
+    static_cast<Client*>(p->data)->status_ = llhttp_get_status_code(p);
+    return 0;
+}
+
+int Client::on_message_complete(llhttp_t* p) {
+    auto* self = static_cast<Client*>(p->data);
+    if (self->pending_.empty()) return -1; // A response nobody asked for
+    uint64_t now = EventLoop::monotonic_us();
+    Pending req = self->pending_.front();
+    self->pending_.pop_front();
+    self->stats_.latency.record(now - req.due_us);
+    self->stats_.service.record(now - req.sent_us);
+    int cls = self->status_ / 100;
+    self->stats_.status[cls >= 1 && cls <= 5 ? cls : 0]++;
+    return 0;
+}
+
+// One loop thread driving `count` connections
+struct ThreadRun {
+    Stats stats;
+
+    // Drops in-flight requests once the grace period is over
+    struct Deadline : TimerNode {
+        std::vector<std::unique_ptr<Client>>* clients = nullptr;
+    };
+
+    void run(const Config& config, int first, int count, uint64_t start_us) {
+        uint64_t end_us = start_us + (uint64_t)(config.duration_s * 1e6);
+        double interval = config.rate > 0 ? 1e6 * config.connections / config.rate : 0;
+
+        std::vector<std::unique_ptr<Client>> clients;
+        for (int i = 0; i < count; ++i) {
+            // Spread the connections' schedules evenly over one interval
+            uint64_t first_us = start_us + (uint64_t)(interval * (first + i) / config.connections);
+            clients.push_back(std::make_unique<Client>(config, stats, start_us, end_us, interval, first_us));
+        }
+
+        EventLoop& loop = EventLoop::instance();
+        Deadline deadline;
+        deadline.clients = &clients;
+        deadline.on_expire = [](TimerNode* n) {
+            for (auto& c : *static_cast<Deadline*>(n)->clients) c->abort();
+        };
+        uint64_t now = EventLoop::monotonic_us();
+        uint64_t grace_us = end_us + (uint64_t)(config.timeout_s * 1e6) - now;
+        loop.timers().schedule(deadline, grace_us / 1000 + 1);
+
+        Signal done;
+        int live = count;
+        stopper(done, loop);
+        for (auto& c : clients) c->run(done, live);
+        if (live > 0) loop.run();
+        if (deadline.scheduled()) loop.timers().cancel(deadline);
+    }
+
+    static FireAndForget stopper(Signal& done, EventLoop& loop) {
+        co_await done;
+        loop.stop();
+    }
+};
+
+void resolve(Config& config) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    std::string port = std::to_string(config.port);
+    if (::getaddrinfo(config.host.c_str(), port.c_str(), &hints, &res) != 0 || !res) {
+        throw std::runtime_error(fmt::format("Cannot resolve {}", config.host));
+    }
+    std::memcpy(&config.addr, res->ai_addr, res->ai_addrlen);
+    config.addr_len = (socklen_t)res->ai_addrlen;
+    ::freeaddrinfo(res);
+}
+
+// http://host[:port][/path]
+void parse_url(Config& config) {
+    std::string_view url = config.url;
+    if (!url.starts_with("http://")) throw std::runtime_error("Only http:// URLs are supported");
+    url.remove_prefix(7);
+    size_t slash = url.find('/');
+    std::string_view authority = url.substr(0, slash);
+    config.path = slash == std::string_view::npos ? "/" : std::string(url.substr(slash));
+    size_t colon = authority.rfind(':');
+    if (colon != std::string_view::npos && authority.find(']', colon) == std::string_view::npos) {
+        config.port = std::atoi(std::string(authority.substr(colon + 1)).c_str());
+        authority = authority.substr(0, colon);
+    }
+    if (authority.starts_with('[') && authority.ends_with(']')) {
+        authority = authority.substr(1, authority.size() - 2);
+    }
+    config.host = std::string(authority);
+    if (config.host.empty() || config.port <= 0) throw std::runtime_error("Bad URL");
+
+    config.request = fmt::format("GET {} HTTP/1.1\r\nHost: {}\r\n", config.path,
+                                 std::string(url.substr(0, slash)));
+    for (const auto& h : config.headers) config.request += h + "\r\n";
+    config.request += "\r\n";
+}
+
+void usage() {
+    std::fprintf(stderr,
+        "Usage: cppcorn-loadgen [options] http://host[:port]/path\n"
+        "  -t, --threads N       loop threads (default 1)\n"
+        "  -c, --connections N   connections over all threads (default 10)\n"
+        "  -d, --duration S      seconds to run (default 10)\n"
+        "  -p, --pipeline N      requests in flight per connection (default 1)\n"
+        "  -R, --rate N          open loop: requests/s over all connections\n"
+        "                        (default 0: closed loop)\n"
+        "  -H, --header H        extra request header, e.g. 'Accept: */*'\n"
+        "      --timeout S       grace period for responses after the run (default 2)\n"
+        "      --json PATH       also write the results as JSON\n");
+}
+
+Config parse_args(int argc, char** argv) {
+    Config config;
+    static const option options[] = {
+        {"threads", required_argument, nullptr, 't'},
+        {"connections", required_argument, nullptr, 'c'},
+        {"duration", required_argument, nullptr, 'd'},
+        {"pipeline", required_argument, nullptr, 'p'},
+        {"rate", required_argument, nullptr, 'R'},
+        {"header", required_argument, nullptr, 'H'},
+        {"timeout", required_argument, nullptr, 'T'},
+        {"json", required_argument, nullptr, 'j'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "t:c:d:p:R:H:h", options, nullptr)) != -1) {
+        switch (opt) {
+            case 't': config.threads = std::atoi(optarg); break;
+            case 'c': config.connections = std::atoi(optarg); break;
+            case 'd': config.duration_s = std::atof(optarg); break;
+            case 'p': config.pipeline = std::atoi(optarg); break;
+            case 'R': config.rate = std::atof(optarg); break;
+            case 'H': config.headers.emplace_back(optarg); break;
+            case 'T': config.timeout_s = std::atof(optarg); break;
+            case 'j': config.json_path = optarg; break;
+            default: usage(); std::exit(opt == 'h' ? 0 : 1);
+        }
+    }
+    if (optind != argc - 1) {
+        usage();
+        std::exit(1);
+    }
+    config.url = argv[optind];
+    config.threads = std::max(1, config.threads);
+    config.connections = std::max(config.threads, config.connections);
+    config.pipeline = std::max(1, config.pipeline);
+    if (config.duration_s <= 0) throw std::runtime_error("--duration must be positive");
+    parse_url(config);
+    resolve(config);
+    return config;
+}
+
+nlohmann::json latency_json(const LatencyHistogram& h) {
+    return {
+        {"count", h.count()},
+        {"min", h.min()},
+        {"mean", h.mean()},
+        {"p50", h.percentile(0.5)},
+        {"p75", h.percentile(0.75)},
+        {"p90", h.percentile(0.9)},
+        {"p99", h.percentile(0.99)},
+        {"p99_9", h.percentile(0.999)},
+        {"p99_99", h.percentile(0.9999)},
+        {"max", h.max()},
+    };
+}
+
+std::string format_us(uint64_t us) {
+    if (us >= 1000000) return fmt::format("{:.2f}s", us / 1e6);
+    if (us >= 1000) return fmt::format("{:.2f}ms", us / 1e3);
+    return fmt::format("{}us", us);
+}
+
+void print_latency(const char* label, const LatencyHistogram& h) {
+    fmt::print("  {:<10} p50 {:>9} p90 {:>9} p99 {:>9} p99.9 {:>9} max {:>9}\n", label,
+               format_us(h.percentile(0.5)), format_us(h.percentile(0.9)),
+               format_us(h.percentile(0.99)), format_us(h.percentile(0.999)), format_us(h.max()));
+}
+
+void report(const Config& config, const Stats& stats) {
+    uint64_t responses = 0;
+    for (uint64_t n : stats.status) responses += n;
+    double rps = responses / config.duration_s;
+    double mbps = stats.bytes / config.duration_s / (1024 * 1024);
+
+    fmt::print("{} responses in {:.1f}s: {:.0f} req/s, {:.2f} MB/s\n", responses,
+               config.duration_s, rps, mbps);
+    fmt::print("Latency{}:\n", config.rate > 0 ? " (from the scheduled send, and from the actual send)" : "");
+    print_latency(config.rate > 0 ? "scheduled" : "all", stats.latency);
+    if (config.rate > 0) print_latency("sent", stats.service);
+    fmt::print("Status: 2xx {}, 3xx {}, 4xx {}, 5xx {}, other {}\n", stats.status[2],
+               stats.status[3], stats.status[4], stats.status[5], stats.status[0] + stats.status[1]);
+    if (stats.connect_errors || stats.read_errors || stats.timeouts || stats.unsent) {
+        fmt::print("Errors: connect {}, read {}, timeout {}, unsent {}\n", stats.connect_errors,
+                   stats.read_errors, stats.timeouts, stats.unsent);
+    }
+
+    if (config.json_path.empty()) return;
+    nlohmann::json out = {
+        {"url", config.url},
+        {"threads", config.threads},
+        {"connections", config.connections},
+        {"pipeline", config.pipeline},
+        {"mode", config.rate > 0 ? "open" : "closed"},
+        {"target_rate", config.rate},
+        {"duration_s", config.duration_s},
+        {"responses", responses},
+        {"requests_per_sec", rps},
+        {"bytes", stats.bytes},
+        {"status", {{"1xx", stats.status[1]}, {"2xx", stats.status[2]}, {"3xx", stats.status[3]},
+                    {"4xx", stats.status[4]}, {"5xx", stats.status[5]}, {"other", stats.status[0]}}},
+        {"errors", {{"connect", stats.connect_errors}, {"read", stats.read_errors},
+                    {"timeout", stats.timeouts}, {"unsent", stats.unsent}}},
+        {"latency_us", latency_json(stats.latency)},
+        {"service_time_us", latency_json(stats.service)},
+    };
+    std::ofstream file(config.json_path);
+    if (!file) throw std::runtime_error(fmt::format("Cannot write {}", config.json_path));
+    file << out.dump(2) << "\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        Config config = parse_args(argc, argv);
+        fmt::print("{} for {}s: {} threads, {} connections, pipeline {}, {}\n", config.url,
+                   config.duration_s, config.threads, config.connections, config.pipeline,
+                   config.rate > 0 ? fmt::format("open loop at {} req/s", config.rate) : "closed loop");
+
+        // Leave time for every thread to connect before the schedule starts
+        uint64_t start_us = EventLoop::monotonic_us() + 200000;
+        std::vector<ThreadRun> runs(config.threads);
+        std::vector<std::thread> threads;
+        int first = 0;
+        for (int i = 0; i < config.threads; ++i) {
+            int count = config.connections / config.threads + (i < config.connections % config.threads ? 1 : 0);
+            threads.emplace_back([&, i, first, count] { runs[i].run(config, first, count, start_us); });
+            first += count;
+        }
+        for (auto& t : threads) t.join();
+
+        Stats total;
+        for (const auto& r : runs) total.merge(r.stats);
+        report(config, total);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "cppcorn-loadgen: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+#endif
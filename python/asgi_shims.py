@@ -0,0 +1,247 @@
+"""The ASGI receive/send shims shared by python/worker.py and
+python/embedded.py. They only differ in how messages reach the bridge: the
+worker encodes frames for its socket, while embedded mode calls into
+_cppcorn. Each passes the shims a Transport."""
+
+import asyncio
+import importlib
+import os
+
+# Response body bytes that may be unacknowledged by the bridge (see protocol.hpp)
+RESPONSE_WINDOW = 256 * 1024
+
+class Transport:
+    """Carries the shims' messages to the bridge, one method per message
+    type (see src/asgi/protocol.hpp)."""
+
+    def start(self, request_id, status, headers):
+        """HTTP_RESPONSE_START; status 101 accepts a websocket."""
+        raise NotImplementedError
+
+    def body(self, request_id, body, more_body):
+        """HTTP_RESPONSE_BODY"""
+        raise NotImplementedError
+
+    def window(self, request_id, n):
+        """HTTP_WINDOW: the app took n bytes of body or messages."""
+        raise NotImplementedError
+
+    def message(self, request_id, data, text):
+        """WEBSOCKET_MESSAGE"""
+        raise NotImplementedError
+
+    def close(self, request_id, code, reason):
+        """WEBSOCKET_CLOSE"""
+        raise NotImplementedError
+
+    async def drain(self):
+        """Waits until the messages so far can be handed over."""
+
+class AsgiShim:
+    """Per-request receive/send. The request body streams in through
+    feed(); each chunk the app receive()s is credited back to the bridge so
+    it sends more. Response messages go out as soon as the app sends them,
+    pausing while RESPONSE_WINDOW bytes are unacknowledged."""
+
+    def __init__(self, transport, request_id, body, more_body):
+        self.transport = transport
+        self.request_id = request_id
+        self.first = (body, more_body)
+        self.more_body = more_body
+        self.chunks = asyncio.Queue()
+        self.finished = asyncio.Event()  # The request is over: done or disconnected
+        self.started = False
+        self.complete = False
+        self.in_flight = 0
+        self.credit = asyncio.Event()
+        self.disconnected = False
+
+    def feed(self, body, more_body):
+        """HTTP_REQUEST_BODY from the bridge."""
+        self.chunks.put_nowait((body, more_body))
+
+    def disconnect(self):
+        """HTTP_DISCONNECT from the bridge: the client is gone."""
+        self.disconnected = True
+        self.chunks.put_nowait((b"", False))
+        self.credit.set()
+        self.finished.set()  # Wakes a receive() waiting for the end of the request
+
+    def acknowledge(self, n):
+        """HTTP_WINDOW from the bridge."""
+        self.in_flight -= n
+        self.credit.set()
+
+    async def send(self, message):
+        if self.disconnected:
+            return  # Nobody to send to
+        if message["type"] == "http.response.start":
+            self.started = True
+            self.transport.start(self.request_id, message["status"], message.get("headers", []))
+        elif message["type"] == "http.response.body" and not self.complete:
+            body = message.get("body", b"")
+            more = message.get("more_body", False)
+            self.complete = not more
+            self.transport.body(self.request_id, body, more)
+            self.in_flight += len(body)
+            while self.in_flight >= RESPONSE_WINDOW and not self.disconnected:
+                self.credit.clear()
+                await self.credit.wait()
+        await self.transport.drain()
+
+    async def receive(self):
+        if self.disconnected:
+            return {"type": "http.disconnect"}
+        if self.first is not None:
+            body, more = self.first
+            self.first = None
+        elif self.more_body:
+            body, more = await self.chunks.get()
+            if self.disconnected:
+                return {"type": "http.disconnect"}
+        else:
+            # Body fully received: the next event is the end of the request
+            await self.finished.wait()
+            return {"type": "http.disconnect"}
+
+        self.more_body = more
+        if body:
+            self.transport.window(self.request_id, len(body))
+        return {"type": "http.request", "body": body, "more_body": more}
+
+class WebSocketShim:
+    """Per-connection receive/send for a websocket scope. The handshake,
+    pings and the close handshake are done by the bridge; the app sees
+    websocket.connect, the client's messages and websocket.disconnect.
+    Messages are flow controlled like bodies: received ones are credited
+    back, and sending pauses while RESPONSE_WINDOW bytes are
+    unacknowledged. A refusal (websocket.close before accepting, or a
+    websocket.http.response) goes out as an HTTP response."""
+
+    def __init__(self, transport, request_id):
+        self.transport = transport
+        self.request_id = request_id
+        self.events = asyncio.Queue()  # (event, bytes to credit)
+        self.events.put_nowait(({"type": "websocket.connect"}, 0))
+        self.finished = asyncio.Event()
+        self.accepted = False
+        self.responded = False  # Refused with an HTTP response
+        self.closed = False
+        self.in_flight = 0
+        self.credit = asyncio.Event()
+        self.disconnected = False
+
+    @property
+    def complete(self):
+        return self.closed or self.disconnected
+
+    def feed(self, data, text):
+        """WEBSOCKET_MESSAGE from the bridge."""
+        if text:
+            event = {"type": "websocket.receive", "text": data.decode("utf-8")}
+        else:
+            event = {"type": "websocket.receive", "bytes": data}
+        self.events.put_nowait((event, len(data)))
+
+    def disconnect(self, code=1006):
+        """WEBSOCKET_CLOSE or HTTP_DISCONNECT from the bridge."""
+        if not self.disconnected:
+            self.disconnected = True
+            self.events.put_nowait(({"type": "websocket.disconnect", "code": code}, 0))
+        self.credit.set()
+
+    def acknowledge(self, n):
+        self.in_flight -= n
+        self.credit.set()
+
+    async def receive(self):
+        event, size = await self.events.get()
+        if size:
+            self.transport.window(self.request_id, size)
+        return event
+
+    async def send(self, message):
+        if self.complete:
+            return  # Nobody to send to
+        kind = message["type"]
+        if kind == "websocket.accept":
+            headers = list(message.get("headers", []))
+            if message.get("subprotocol"):
+                headers.append((b"sec-websocket-protocol", message["subprotocol"].encode("latin-1")))
+            self.accepted = True
+            self.transport.start(self.request_id, 101, headers)
+        elif kind == "websocket.send" and self.accepted:
+            if message.get("bytes") is not None:
+                data, text = message["bytes"], False
+            else:
+                data, text = message.get("text", "").encode("utf-8"), True
+            self.transport.message(self.request_id, data, text)
+            self.in_flight += len(data)
+            while self.in_flight >= RESPONSE_WINDOW and not self.disconnected:
+                self.credit.clear()
+                await self.credit.wait()
+        elif kind == "websocket.close":
+            self.closed = True
+            if self.accepted:
+                reason = (message.get("reason") or "").encode("utf-8")
+                self.transport.close(self.request_id, message.get("code", 1000), reason)
+            elif not self.responded:
+                self.transport.start(self.request_id, 403, [])
+                self.transport.body(self.request_id, b"", False)
+        elif kind == "websocket.http.response.start" and not self.accepted:
+            self.responded = True
+            self.transport.start(self.request_id, message["status"], message.get("headers", []))
+        elif kind == "websocket.http.response.body" and self.responded:
+            more = message.get("more_body", False)
+            self.closed = not more
+            self.transport.body(self.request_id, message.get("body", b""), more)
+        await self.transport.drain()
+
+def websocket_scope(scope):
+    """Turns an HTTP scope for an upgrade request into a websocket one."""
+    del scope["method"]
+    scope["type"] = "websocket"
+    scope["scheme"] = "ws"
+    protocols = b",".join(v for k, v in scope["headers"] if k == b"sec-websocket-protocol")
+    scope["subprotocols"] = [p.strip().decode("latin-1") for p in protocols.split(b",") if p.strip()]
+    scope["extensions"] = {"websocket.http.response": {}}
+    return scope
+
+async def handle_websocket(app, shim, scope):
+    try:
+        await app(scope, shim.receive, shim.send)
+    except Exception as e:
+        print(f"App Error: {e}")
+    # End a socket the app left open: refused if never accepted
+    if shim.complete:
+        return
+    if shim.responded:
+        await shim.send({"type": "websocket.http.response.body"})
+    else:
+        await shim.send({"type": "websocket.close", "code": 1000})
+
+async def handle_request(app, shim, scope):
+    try:
+        await app(scope, shim.receive, shim.send)
+        # Finish a response the app left open
+        if not shim.started:
+            await shim.send({"type": "http.response.start", "status": 500, "headers": []})
+        if not shim.complete:
+            await shim.send({"type": "http.response.body"})
+
+    except Exception as e:
+        print(f"App Error: {e}")
+        if not shim.started:
+            # Send 500
+            await shim.send({"type": "http.response.start", "status": 500, "headers": []})
+            await shim.send({"type": "http.response.body", "body": str(e).encode('utf-8')})
+        elif not shim.complete:
+            await shim.send({"type": "http.response.body"})
+
+def load_app():
+    # CPPCORN_APP selects the ASGI app as "module:attribute"
+    module_name, _, app_name = os.environ.get("CPPCORN_APP", "demo.main:app").partition(":")
+    app_name = app_name or "app"
+    app = getattr(importlib.import_module(module_name), app_name)
+    print(f"Loaded {module_name}:{app_name}")
+    return app
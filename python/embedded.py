@@ -0,0 +1,97 @@
+"""Glue for CppCorn's embedded mode (CPPCORN_EMBED=1, src/asgi/embedded.hpp).
+
+Each interpreter thread imports this module and runs serve(). Requests come
+from the bridge in the same process through the _cppcorn module, already
+turned into ASGI scopes, and responses go back the same way: no sockets, no
+frames. The shims are shared with python/worker.py (python/asgi_shims.py)."""
+
+import asyncio
+import os
+import sys
+
+import _cppcorn
+from asgi_shims import (AsgiShim, Transport, WebSocketShim, handle_request,
+                        handle_websocket, load_app, websocket_scope)
+
+# Add project root to sys.path so we can import demo
+sys.path.append(os.getcwd())
+
+# Event types (see src/asgi/protocol.hpp)
+TYPE_HTTP_REQUEST = 2
+TYPE_HTTP_REQUEST_BODY = 5
+TYPE_HTTP_WINDOW = 6
+TYPE_HTTP_DISCONNECT = 7
+TYPE_WEBSOCKET_CONNECT = 8
+TYPE_WEBSOCKET_MESSAGE = 9
+TYPE_WEBSOCKET_CLOSE = 10
+
+class CppcornTransport(Transport):
+    """Hands the shims' messages straight to the bridge."""
+    start = staticmethod(_cppcorn.start)
+    body = staticmethod(_cppcorn.body)
+    window = staticmethod(_cppcorn.window)
+    message = staticmethod(_cppcorn.message)
+    close = staticmethod(_cppcorn.close)
+
+async def main():
+    try:
+        app = load_app()
+    except Exception as e:
+        print(f"Failed to load app: {e}")
+        return
+
+    loop = asyncio.get_running_loop()
+    stopped = loop.create_future()
+    tasks = set()
+    requests = {}  # request id -> AsgiShim, while its task runs
+    transport = CppcornTransport()
+
+    def finished(request_id, task):
+        tasks.discard(task)
+        shim = requests.pop(request_id, None)
+        if shim:
+            shim.finished.set()
+
+    def pump():
+        for event in _cppcorn.take():
+            msg_type, request_id = event[0], event[1]
+            if msg_type in (TYPE_HTTP_REQUEST, TYPE_WEBSOCKET_CONNECT):
+                scope, body, more_body = event[2:]
+                if msg_type == TYPE_HTTP_REQUEST:
+                    shim = AsgiShim(transport, request_id, body, more_body)
+                    handler = handle_request(app, shim, scope)
+                else:
+                    shim = WebSocketShim(transport, request_id)
+                    handler = handle_websocket(app, shim, websocket_scope(scope))
+                requests[request_id] = shim
+                task = loop.create_task(handler)
+                tasks.add(task)
+                task.add_done_callback(lambda t, rid=request_id: finished(rid, t))
+                continue
+            if msg_type == TYPE_HTTP_DISCONNECT and request_id == 0:
+                if not stopped.done():
+                    stopped.set_result(None)
+                continue
+            shim = requests.get(request_id)
+            if not shim:
+                continue
+            if msg_type == TYPE_HTTP_REQUEST_BODY:
+                shim.feed(event[2], event[3])
+            elif msg_type == TYPE_HTTP_WINDOW:
+                shim.acknowledge(event[2])
+            elif msg_type == TYPE_WEBSOCKET_MESSAGE:
+                shim.feed(event[2], event[3])
+            elif msg_type == TYPE_WEBSOCKET_CLOSE:
+                shim.disconnect(event[2])
+            elif msg_type == TYPE_HTTP_DISCONNECT:
+                shim.disconnect()
+
+    loop.add_reader(_cppcorn.fileno(), pump)
+    pump()  # Requests posted while the app loaded
+    await stopped
+    loop.remove_reader(_cppcorn.fileno())
+    for task in tasks:
+        task.cancel()
+
+def serve():
+    asyncio.run(main())
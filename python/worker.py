@@ -1,17 +1,32 @@
 import asyncio
 import struct
-import json
 import os
 import sys
-import importlib
-from io import BytesIO
+import mmap
+import socket
+from urllib.parse import unquote
+
+from asgi_shims import (AsgiShim, Transport, WebSocketShim, handle_request,
+                        handle_websocket, load_app, websocket_scope)
 
 # Add project root to sys.path so we can import demo
 sys.path.append(os.getcwd())
 
 # Protocol constants
 TYPE_JSON = 1
-TYPE_BINARY = 2
+TYPE_HTTP_REQUEST = 2
+TYPE_HTTP_RESPONSE_START = 3
+TYPE_HTTP_RESPONSE_BODY = 4
+TYPE_HTTP_REQUEST_BODY = 5
+TYPE_HTTP_WINDOW = 6
+TYPE_HTTP_DISCONNECT = 7
+TYPE_WEBSOCKET_CONNECT = 8
+TYPE_WEBSOCKET_MESSAGE = 9
+TYPE_WEBSOCKET_CLOSE = 10
+
+# Frame header: [u32 length][u8 type][u32 request id], little endian (host).
+# length counts type + request id + payload.
+HEADER = struct.Struct('<IBI')
 
 async def read_exactly(reader, n):
     if hasattr(reader, 'readexact'):
@@ -21,88 +36,312 @@ async def read_exactly(reader, n):
         data = await reader.readexactly(n)
     return data
 
-async def send_message(writer, msg_type, payload):
-    # Length = payload_len + 1 (type)
-    length = len(payload) + 1
-    writer.write(struct.pack('<I', length)) # Little endian (host)
-    writer.write(struct.pack('B', msg_type))
-    writer.write(payload)
+# Binary payload fields (see src/asgi/protocol.hpp); strings are prefixed
+# with a u16 or u32 length.
+U8 = struct.Struct('<B')
+U16 = struct.Struct('<H')
+U32 = struct.Struct('<I')
+
+def frame(msg_type, request_id, payload):
+    return HEADER.pack(len(payload) + 5, msg_type, request_id) + payload
+
+async def send_message(writer, msg_type, request_id, payload):
+    # One write per frame so concurrent requests can't interleave their bytes
+    writer.write(frame(msg_type, request_id, payload))
     await writer.drain()
 
-class AsgiShim:
-    def __init__(self, app):
-        self.app = app
-        self.response = {}
+class ShmRing:
+    """One direction of the bridge's shared-memory ring pair (see
+    src/asgi/shm_transport.hpp): a single-producer/single-consumer byte ring
+    with free-running head/tail positions. Plain loads and stores are enough
+    here because x86-64 keeps them in program order; Python has no fences,
+    so the server only offers this transport on x86-64 (src/main.cpp)."""
+    POS = struct.Struct('<Q')
+    HEAD, TAIL, DATA = 0, 64, 128
+
+    def __init__(self, mm, offset, capacity):
+        self.mm = mm
+        self.off = offset
+        self.data = offset + self.DATA
+        self.capacity = capacity
+        self.mask = capacity - 1
+
+    def _load(self, field):
+        return self.POS.unpack_from(self.mm, self.off + field)[0]
+
+    def _store(self, field, value):
+        self.POS.pack_into(self.mm, self.off + field, value)
+
+    def read(self):
+        """Takes everything available. Returns (bytes, fill level before)."""
+        tail = self._load(self.TAIL)
+        head = self._load(self.HEAD)
+        n = tail - head
+        if not n:
+            return b'', 0
+        start = head & self.mask
+        first = min(n, self.capacity - start)
+        data = self.mm[self.data + start:self.data + start + first]
+        if n > first:
+            data += self.mm[self.data:self.data + n - first]
+        self._store(self.HEAD, tail)
+        return data, n
+
+    def write(self, data):
+        """Copies as much of data as fits. Returns the bytes copied."""
+        head = self._load(self.HEAD)
+        tail = self._load(self.TAIL)
+        n = min(len(data), self.capacity - (tail - head))
+        if not n:
+            return 0
+        start = tail & self.mask
+        first = min(n, self.capacity - start)
+        view = memoryview(data)
+        self.mm[self.data + start:self.data + start + first] = view[:first]
+        if n > first:
+            self.mm[self.data:self.data + n - first] = view[first:n]
+        self._store(self.TAIL, tail + n)
+        return n
+
+class ShmStream:
+    """Bridge transport over shared memory (CPPCORN_IPC=shm). The bridge
+    passes a memfd and three eventfds over the unix socket; afterwards the
+    socket only tells us when the bridge goes away. Provides the
+    readexactly/write/drain subset of asyncio streams that the worker uses."""
+
+    def __init__(self, sock, fds, ring_size):
+        memfd, self.bell, self.data_bell, self.space_bell = fds
+        ring_bytes = ShmRing.DATA + ring_size
+        self.mm = mmap.mmap(memfd, 2 * ring_bytes)
+        os.close(memfd)
+        self.rx = ShmRing(self.mm, 0, ring_size)           # bridge -> worker
+        self.tx = ShmRing(self.mm, ring_bytes, ring_size)  # worker -> bridge
+
+        self.sock = sock
+        self.closed = False
+        self.buf = bytearray()
+        self.out = bytearray()
+        self.flushing = False
+        self.wakeup = asyncio.Event()
+
+        loop = asyncio.get_running_loop()
+        loop.add_reader(self.bell, self._ring)
+        loop.add_reader(sock.fileno(), self._peer_closed)
+
+    def _ring(self):
+        try:
+            os.eventfd_read(self.bell)
+        except BlockingIOError:
+            return
+        self.wakeup.set()
+
+    def _peer_closed(self):
+        asyncio.get_running_loop().remove_reader(self.sock.fileno())
+        self.closed = True
+        self.wakeup.set()
+
+    async def readexactly(self, n):
+        while len(self.buf) < n:
+            self.wakeup.clear()
+            data, used = self.rx.read()
+            if data:
+                self.buf += data
+                if used >= self.rx.capacity // 2:
+                    os.eventfd_write(self.space_bell, 1)
+                continue
+            if self.closed:
+                raise asyncio.IncompleteReadError(bytes(self.buf), n)
+            await self.wakeup.wait()
+        data = bytes(self.buf[:n])
+        del self.buf[:n]
+        return data
+
+    def write(self, data):
+        # Frames queue up and go out in batches, one doorbell per batch
+        self.out += data
+        if not self.flushing:
+            self.flushing = True
+            asyncio.get_running_loop().create_task(self._flush())
+
+    async def drain(self):
+        pass
+
+    async def _flush(self):
+        try:
+            while self.out and not self.closed:
+                self.wakeup.clear()
+                n = self.tx.write(self.out)
+                if n:
+                    del self.out[:n]
+                    os.eventfd_write(self.data_bell, 1)
+                    continue
+                # Ring full: the bridge rings us once it drains it. Re-check
+                # every millisecond in case that raced with us.
+                try:
+                    await asyncio.wait_for(self.wakeup.wait(), 0.001)
+                except asyncio.TimeoutError:
+                    pass
+        finally:
+            self.flushing = False
+
+async def connect():
+    """Connects to the bridge using the transport it spawned us with."""
+    path = os.environ.get("CPPCORN_IPC_PATH")
+    if not path:
+        port = int(os.environ.get("CPPCORN_IPC_PORT", "8001"))
+        print(f"Connecting to CppCorn on port {port}...")
+        return await asyncio.open_connection('127.0.0.1', port)
+
+    print(f"Connecting to CppCorn on {path}...")
+    address = "\0" + path[1:] if path.startswith("@") else path  # '@' = abstract namespace
+    if not os.environ.get("CPPCORN_IPC_SHM"):
+        return await asyncio.open_unix_connection(address)
+
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(address)
+    msg, fds, _, _ = socket.recv_fds(sock, 8, 4)
+    if len(fds) != 4:
+        raise ConnectionError("Bridge did not send shared memory handles")
+    sock.setblocking(False)
+    stream = ShmStream(sock, fds, struct.unpack('<Q', msg)[0])
+    return stream, stream
+
+def decode_request(payload):
+    """Decodes an HTTP_REQUEST payload into
+    (method, path, query, headers, body, more_body)."""
+    view = memoryview(payload)
+    pos = 0
+
+    def string(length):
+        nonlocal pos
+        n = length.unpack_from(view, pos)[0]
+        pos += length.size
+        value = bytes(view[pos:pos + n])
+        pos += n
+        return value
+
+    method = string(U16)
+    path = string(U32)
+    query = string(U32)
+    count = U16.unpack_from(view, pos)[0]
+    pos += U16.size
+    headers = [(string(U16), string(U32)) for _ in range(count)]
+    more_body = view[pos] != 0
+    pos += 1
+    body = string(U32)
+    return method, path, query, headers, body, more_body
+
+def encode_response_start(status, headers):
+    parts = [U16.pack(status), U16.pack(len(headers))]
+    for name, value in headers:
+        parts += [U16.pack(len(name)), name, U32.pack(len(value)), value]
+    return b"".join(parts)
+
+class FrameTransport(Transport):
+    """Sends the shims' messages to the bridge as frames on its socket."""
 
-    async def send(self, message):
-        if message["type"] == "http.response.start":
-            self.response["status"] = message["status"]
-            self.response["headers"] = [[k.decode(), v.decode()] for k, v in message.get("headers", [])]
-        elif message["type"] == "http.response.body":
-            self.response["body"] = message.get("body", b"").decode('utf-8')
+    def __init__(self, writer):
+        self.writer = writer
 
-    async def receive(self):
-        return {"type": "http.request"}
+    def start(self, request_id, status, headers):
+        self.writer.write(frame(TYPE_HTTP_RESPONSE_START, request_id, encode_response_start(status, headers)))
+
+    def body(self, request_id, body, more_body):
+        self.writer.write(frame(TYPE_HTTP_RESPONSE_BODY, request_id, U8.pack(1 if more_body else 0) + body))
+
+    def window(self, request_id, n):
+        self.writer.write(frame(TYPE_HTTP_WINDOW, request_id, U32.pack(n)))
+
+    def message(self, request_id, data, text):
+        self.writer.write(frame(TYPE_WEBSOCKET_MESSAGE, request_id, U8.pack(1 if text else 0) + data))
+
+    def close(self, request_id, code, reason):
+        self.writer.write(frame(TYPE_WEBSOCKET_CLOSE, request_id, U16.pack(code) + reason))
+
+    async def drain(self):
+        await self.writer.drain()
+
+def build_scope(method, path, query, headers):
+    return {
+        "type": "http",
+        "asgi": {"version": "3.0", "spec_version": "2.1"},
+        "http_version": "1.1",
+        "server": ("127.0.0.1", 8000),
+        "client": ("127.0.0.1", 0),
+        "scheme": "http",
+        "method": method.decode("latin-1"),
+        "path": unquote(path.decode("latin-1")),
+        "raw_path": path,
+        "query_string": query,
+        "headers": headers,
+    }
 
 async def worker_loop(reader, writer):
     print("Worker connected to CppCorn.")
     
     # Load App
     try:
-        module_name, app_name = "demo.main", "app"
-        module = importlib.import_module(module_name)
-        app = getattr(module, app_name)
-        print(f"Loaded {module_name}:{app_name}")
+        app = load_app()
     except Exception as e:
         print(f"Failed to load app: {e}")
         return
 
+    # Each request runs as its own task, so a slow handler doesn't hold up
+    # the ones behind it. Keep references until they finish.
+    tasks = set()
+    requests = {}  # request id -> AsgiShim, while its task runs
+    transport = FrameTransport(writer)
+
+    def finished(request_id, task):
+        tasks.discard(task)
+        shim = requests.pop(request_id, None)
+        if shim:
+            shim.finished.set()
+
     while True:
         try:
             # Read header
-            header = await read_exactly(reader, 5)
-            length, msg_type = struct.unpack('<IB', header)
+            header = await read_exactly(reader, HEADER.size)
+            length, msg_type, request_id = HEADER.unpack(header)
             
-            payload = await read_exactly(reader, length - 1)
+            payload = await read_exactly(reader, length - 5)
             
-            if msg_type == TYPE_JSON:
-                scope_data = json.loads(payload)
-                
-                # Construct ASGI Scope
-                scope = {
-                    "type": "http",
-                    "asgi": {"version": "3.0", "spec_version": "2.1"},
-                    "http_version": "1.1",
-                    "server": ("127.0.0.1", 8000),
-                    "client": ("127.0.0.1", 0),
-                    "scheme": "http",
-                    "method": scope_data.get("method", "GET"),
-                    "path": scope_data.get("path", "/"),
-                    "raw_path": scope_data.get("path", "/").encode(),
-                    "query_string": b"",
-                    "headers": [
-                        (k.lower().encode(), v.encode()) 
-                        for k, v in scope_data.get("headers", [])
-                    ],
-                }
-
-                shim = AsgiShim(app)
-                try:
-                    await app(scope, shim.receive, shim.send)
-                    
-                    # Send response back to C++
-                    # Flatten headers for JSON
-                    response_payload = {
-                        "status": shim.response.get("status", 200),
-                        "body": shim.response.get("body", ""),
-                        "headers": shim.response.get("headers", [])
-                    }
-                    await send_message(writer, TYPE_JSON, json.dumps(response_payload).encode('utf-8'))
-                    
-                except Exception as e:
-                    print(f"App Error: {e}")
-                    # Send 500
-                    await send_message(writer, TYPE_JSON, json.dumps({"status": 500, "body": str(e)}).encode('utf-8'))
+            if msg_type == TYPE_HTTP_REQUEST:
+                method, path, query, headers, body, more_body = decode_request(payload)
+                shim = AsgiShim(transport, request_id, body, more_body)
+                requests[request_id] = shim
+                scope = build_scope(method, path, query, headers)
+                task = asyncio.create_task(handle_request(app, shim, scope))
+                tasks.add(task)
+                task.add_done_callback(lambda t, rid=request_id: finished(rid, t))
+            elif msg_type == TYPE_WEBSOCKET_CONNECT:
+                method, path, query, headers, _, _ = decode_request(payload)
+                shim = WebSocketShim(transport, request_id)
+                requests[request_id] = shim
+                scope = websocket_scope(build_scope(method, path, query, headers))
+                task = asyncio.create_task(handle_websocket(app, shim, scope))
+                tasks.add(task)
+                task.add_done_callback(lambda t, rid=request_id: finished(rid, t))
+            elif msg_type == TYPE_WEBSOCKET_MESSAGE:
+                shim = requests.get(request_id)
+                if shim:
+                    shim.feed(bytes(payload[1:]), payload[0] != 0)
+            elif msg_type == TYPE_WEBSOCKET_CLOSE:
+                shim = requests.get(request_id)
+                if shim:
+                    shim.disconnect(U16.unpack_from(payload)[0])
+            elif msg_type == TYPE_HTTP_REQUEST_BODY:
+                shim = requests.get(request_id)
+                if shim:
+                    shim.feed(bytes(payload[1:]), payload[0] != 0)
+            elif msg_type == TYPE_HTTP_WINDOW:
+                shim = requests.get(request_id)
+                if shim:
+                    shim.acknowledge(U32.unpack_from(payload)[0])
+            elif msg_type == TYPE_HTTP_DISCONNECT:
+                shim = requests.get(request_id)
+                if shim:
+                    shim.disconnect()
                 
         except asyncio.IncompleteReadError:
             print("Server disconnected")
@@ -112,12 +351,10 @@ async def worker_loop(reader, writer):
             break
 
 async def main():
-    # Connect to C++ server (Bridge)
-    # We assume C++ listens on 8001 (configured in Bridge)
-    port = int(os.environ.get("CPPCORN_IPC_PORT", "8001"))
-    print(f"Connecting to CppCorn on port {port}...")
+    # Connect to C++ server (Bridge). The bridge spawns us with its address in
+    # CPPCORN_IPC_PATH (unix/shm) or CPPCORN_IPC_PORT (tcp).
     try:
-        reader, writer = await asyncio.open_connection('127.0.0.1', port)
+        reader, writer = await connect()
         await worker_loop(reader, writer)
     except Exception as e:
         print(f"Could not connect to CppCorn: {e}")
@@ -0,0 +1,109 @@
+#include "admission.hpp"
+#include "../core/event_loop.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace cppcorn::asgi {
+
+Admission::Admission(AdmissionConfig config) : config_(config), metrics_(core::Metrics::local()) {
+    config_.min_limit = std::max<size_t>(config_.min_limit, 1);
+    config_.max_limit = std::max(config_.max_limit, config_.min_limit);
+    config_.max_queue = std::max<size_t>(config_.max_queue, 1);
+    limit_ = (double)std::clamp(config_.initial_limit, config_.min_limit, config_.max_limit);
+    publish();
+}
+
+Admission::~Admission() {
+    for (Waiter* w : queue_) core::EventLoop::instance().timers().cancel(*w);
+}
+
+core::Task<Admission::Permit> Admission::acquire() {
+    if (queue_.empty() && in_flight_ < limit()) {
+        ++in_flight_;
+        publish();
+        co_return Permit(this);
+    }
+    if (saturated()) {
+        ++shed_;
+        metrics_.error(core::ErrorKind::Shed);
+        co_return Permit();
+    }
+
+    Waiter waiter;
+    co_await Enqueue{*this, waiter};
+    if (!waiter.granted) {
+        ++shed_;
+        metrics_.error(core::ErrorKind::Shed);
+        co_return Permit();
+    }
+    co_return Permit(this); // Counted in flight when granted
+}
+
+void Admission::Enqueue::await_suspend(std::coroutine_handle<> h) {
+    waiter.owner = &admission;
+    waiter.handle = h;
+    waiter.pos = admission.queue_.insert(admission.queue_.end(), &waiter);
+    admission.publish();
+    waiter.on_expire = [](core::TimerNode* n) {
+        auto* w = static_cast<Waiter*>(n);
+        w->owner->queue_.erase(w->pos);
+        w->owner->publish();
+        w->owner->resume_accept();
+        w->handle.resume();
+    };
+    core::EventLoop::instance().timers().schedule(waiter, admission.config_.max_wait_ms);
+}
+
+void Admission::release(uint64_t response_us) {
+    if (response_us > 0) update_limit(response_us);
+    --in_flight_;
+    admit_waiters();
+}
+
+void Admission::update_limit(uint64_t response_us) {
+    double sample = (double)response_us;
+    if (long_us_ == 0) {
+        long_us_ = sample;
+    } else {
+        long_us_ += (sample - long_us_) / LONG_WINDOW;
+    }
+    // Load has dropped well below what the average remembers: let it catch
+    // up rather than keep holding the limit at its ceiling
+    if (long_us_ > 2 * sample) long_us_ *= 0.95;
+
+    double gradient = std::clamp(TOLERANCE * long_us_ / sample, 0.5, 1.0);
+    double estimate = limit_ * gradient + std::sqrt(limit_);
+    // Only grow a limit that is actually being used
+    if ((double)in_flight_ < limit_ / 2) estimate = std::min(estimate, limit_);
+
+    limit_ = std::clamp(limit_ * (1 - SMOOTHING) + estimate * SMOOTHING,
+                        (double)config_.min_limit, (double)config_.max_limit);
+}
+
+void Admission::admit_waiters() {
+    // A resumed request may release or acquire in turn; the loop re-checks
+    while (!queue_.empty() && in_flight_ < limit()) {
+        Waiter* w = queue_.front();
+        queue_.pop_front();
+        core::EventLoop::instance().timers().cancel(*w);
+        ++in_flight_;
+        w->granted = true;
+        w->handle.resume();
+    }
+    publish();
+    resume_accept();
+}
+
+void Admission::resume_accept() {
+    if (accept_waiter_ && queue_.size() <= config_.max_queue / 2) {
+        std::exchange(accept_waiter_, nullptr).resume();
+    }
+}
+
+void Admission::publish() {
+    metrics_.admission_limit.set((int64_t)limit());
+    metrics_.admission_in_flight.set((int64_t)in_flight_);
+    metrics_.admission_queued.set((int64_t)queue_.size());
+}
+
+} // namespace cppcorn::asgi
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "../core/coroutine.hpp"
+#include "../core/timer.hpp"
+#include "../core/metrics.hpp"
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <utility>
+
+namespace cppcorn::asgi {
+
+struct AdmissionConfig {
+    size_t min_limit = 1;        // The limit never drops below this (the thread's workers)
+    size_t initial_limit = 16;
+    size_t max_limit = 1000;
+    size_t max_queue = 1024;     // Requests waiting for a slot; more are shed
+    uint64_t max_wait_ms = 5000; // Longest a request waits for a slot before it is shed
+};
+
+// Adaptive concurrency limit in front of one loop thread's bridge. Each
+// request forwarded to a worker holds a permit until its response is
+// complete. The limit follows the workers' response times (gradient
+// method): while the latest response time stays within TOLERANCE of the
+// long-term average it grows by about sqrt(limit) per sample, and as
+// responses slow down it shrinks in proportion, so requests queue here
+// instead of inside the workers. Requests beyond the limit wait in a
+// bounded FIFO; when that is full, or a request has waited max_wait_ms, it
+// is shed and should be answered with a 503 straight away.
+class Admission {
+public:
+    static constexpr double TOLERANCE = 1.5;     // Response time growth accepted as noise
+    static constexpr double SMOOTHING = 0.2;     // Weight of each new limit estimate
+    static constexpr double LONG_WINDOW = 600;   // Samples in the long-term average
+
+    // Held while a request occupies a worker. An empty permit means the
+    // request was shed.
+    class Permit {
+    public:
+        Permit() = default;
+        Permit(Permit&& other) noexcept : owner_(std::exchange(other.owner_, nullptr)) {}
+        Permit& operator=(Permit&& other) noexcept {
+            if (this != &other) {
+                release(0);
+                owner_ = std::exchange(other.owner_, nullptr);
+            }
+            return *this;
+        }
+        ~Permit() { release(0); }
+
+        explicit operator bool() const { return owner_ != nullptr; }
+
+        // Frees the slot; a non-zero `response_us` (the worker's time to
+        // respond) feeds the limit
+        void release(uint64_t response_us) {
+            if (auto* owner = std::exchange(owner_, nullptr)) owner->release(response_us);
+        }
+
+    private:
+        friend class Admission;
+        explicit Permit(Admission* owner) : owner_(owner) {}
+        Admission* owner_ = nullptr;
+    };
+
+    explicit Admission(AdmissionConfig config);
+    ~Admission();
+
+    Admission(const Admission&) = delete;
+    Admission& operator=(const Admission&) = delete;
+
+    // Waits for a slot. Returns an empty permit if the request is shed.
+    core::Task<Permit> acquire();
+
+    // Resumes once the wait queue is below half full, so a server stops
+    // accepting connections while it is shedding
+    struct Accepting {
+        Admission& admission;
+        bool await_ready() const noexcept { return !admission.saturated(); }
+        void await_suspend(std::coroutine_handle<> h) { admission.accept_waiter_ = h; }
+        void await_resume() const noexcept {}
+    };
+    Accepting accepting() { return Accepting{*this}; }
+
+    bool saturated() const { return queue_.size() >= config_.max_queue; }
+    size_t limit() const { return (size_t)limit_; }
+    size_t in_flight() const { return in_flight_; }
+    size_t queued() const { return queue_.size(); }
+    uint64_t shed() const { return shed_; }
+
+private:
+    struct Waiter : core::TimerNode {
+        Admission* owner = nullptr;
+        std::coroutine_handle<> handle;
+        std::list<Waiter*>::iterator pos;
+        bool granted = false;
+    };
+    struct Enqueue {
+        Admission& admission;
+        Waiter& waiter;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h);
+        void await_resume() const noexcept {}
+    };
+
+    void release(uint64_t response_us);
+    void update_limit(uint64_t response_us);
+    void admit_waiters();
+    void resume_accept();
+    void publish(); // Mirrors our state into the thread's metrics
+
+    AdmissionConfig config_;
+    double limit_;
+    double long_us_ = 0; // Long-term average response time
+    size_t in_flight_ = 0;
+    uint64_t shed_ = 0;
+    std::list<Waiter*> queue_; // Oldest first
+    std::coroutine_handle<> accept_waiter_;
+    core::Metrics& metrics_;
+};
+
+} // namespace cppcorn::asgi
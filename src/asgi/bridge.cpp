@@ -1,78 +1,682 @@
 #include "bridge.hpp"
 #include "protocol.hpp"
 #include <fmt/core.h>
+#include "../core/timeout.hpp"
 #include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+
+#ifdef _WIN32
+#include <mutex>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
 
 namespace cppcorn::asgi {
 
-Bridge::Bridge() {
+Bridge::Bridge(WorkerConfig config) : config_(std::move(config)) {
 }
 
 Bridge::~Bridge() {}
 
-void Bridge::listen() {
-    ipc_socket_ = core::Socket(INVALID_SOCKET_VAL); // Create new
-    ipc_socket_.bind("127.0.0.1", 8005);
+void Bridge::start() {
+#ifndef _WIN32
+    if (config_.embedded) {
+        fmt::print("Running the app on {} embedded interpreter thread(s)...\n", config_.count);
+        for (int i = 0; i < config_.count; ++i) {
+            spawn_worker();
+        }
+        return;
+    }
+#endif
+    if (config_.transport == IpcTransport::Tcp) {
+        ipc_socket_.bind("127.0.0.1", 0); // Ephemeral port, passed to the workers
+    } else {
+#ifndef _WIN32
+        static std::atomic<int> next_bridge{0};
+        ipc_path_ = fmt::format("@cppcorn-{}-{}", getpid(), next_bridge++);
+        ipc_socket_ = core::Socket::unix_stream();
+        ipc_socket_.bind_unix(ipc_path_);
+#endif
+    }
     ipc_socket_.listen();
-    fmt::print("Bridge listening on 127.0.0.1:8005 for Workers...\n");
-}
-
-void Bridge::accept_worker() {
-    // Sync accept for prototype simplicity
-    // In production this would be async loop accepting multiple workers
-    fmt::print("Waiting for worker connection...\n");
-    // Hack: loop until we get one (blocking-ish but manual)
-    // Actually, let's just make it blocking for the 'setup' phase.
-    
-    // We need to set blocking temporarily? Socket is blocking by default until set_non_blocking called.
-    // Our Socket constructor creates a blocking socket by default logic? 
-    // Yes, unless set_non_blocking is called.
-    
-    // However, our `Socket` wrapper wraps `socket()` which is blocking.
-    // So `accept` will block.
-    auto sock = ipc_socket_.accept();
-    if (sock) {
-        worker_socket_ = std::move(*sock);
-        worker_socket_.set_non_blocking();
-        fmt::print("Worker connected!\n");
+    ipc_socket_.set_non_blocking();
+
+    if (config_.transport == IpcTransport::Tcp) {
+        ipc_port_ = ipc_socket_.local_port();
+        fmt::print("Bridge listening on 127.0.0.1:{} for {} worker(s)...\n", ipc_port_, config_.count);
     } else {
-        fmt::print("Failed to accept worker (would block?)\n");
+        fmt::print("Bridge listening on {} ({}) for {} worker(s)...\n", ipc_path_,
+                   config_.transport == IpcTransport::Shm ? "shm" : "unix", config_.count);
     }
+
+    accept_loop();
+    for (int i = 0; i < config_.count; ++i) {
+        spawn_worker();
+    }
+    supervise();
 }
 
+// ----------------------------------------------------------------------------
+// Worker processes
+// ----------------------------------------------------------------------------
+
 void Bridge::spawn_worker() {
-    // Manual for now
-    fmt::print("Please run 'python python/worker.py' in a separate terminal.\n");
-}
-
-core::Task<void> Bridge::send_request(const nlohmann::json& scope) {
-    auto data = Protocol::encode(scope);
-    co_await worker_socket_.write(std::span(data.data(), data.size()));
-}
-
-core::Task<nlohmann::json> Bridge::receive_response() {
-    char header_buf[5];
-    size_t total = 0;
-    while (total < 5) {
-        size_t r = co_await worker_socket_.read(std::span(header_buf + total, 5 - total));
-        if (r == 0) throw std::runtime_error("IPC Closed");
-        total += r;
-    }
-    
-    uint32_t len;
-    std::memcpy(&len, header_buf, 4);
-    
-    size_t payload_len = len - 1;
-    std::vector<char> payload(payload_len);
-    total = 0;
-    while (total < payload_len) {
-        size_t r = co_await worker_socket_.read(std::span(payload.data() + total, payload_len - total));
-        if (r == 0) throw std::runtime_error("IPC Closed pending payload");
-        total += r;
-    }
-
-    std::string_view sv(payload.data(), payload_len);
-    co_return nlohmann::json::parse(sv);
+    last_spawn_ms_ = core::EventLoop::monotonic_ms();
+
+#ifndef _WIN32
+    if (config_.embedded) {
+        // Ready at once: requests queue until the app has loaded
+        auto ch = std::make_unique<Channel>();
+        ch->interpreter = std::make_unique<Interpreter>(config_.script);
+        add_channel(std::move(ch));
+        return;
+    }
+#endif
+
+#ifdef _WIN32
+    // The child inherits our environment; serialise set+spawn across loop threads
+    static std::mutex spawn_mutex;
+    std::lock_guard<std::mutex> lock(spawn_mutex);
+    SetEnvironmentVariableA("CPPCORN_IPC_PORT", std::to_string(ipc_port_).c_str());
+
+    std::string cmd = fmt::format("\"{}\" \"{}\"", config_.python, config_.script);
+    STARTUPINFOA si{};
+    si.cb = sizeof(si);
+    PROCESS_INFORMATION pi{};
+    if (!CreateProcessA(NULL, cmd.data(), NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi)) {
+        fmt::print("Failed to spawn worker: {}\n", GetLastError());
+        return;
+    }
+    CloseHandle(pi.hThread);
+    worker_pids_.push_back((long long)(intptr_t)pi.hProcess);
+#else
+    // Tell the worker where to connect (and replace any inherited settings)
+    std::vector<std::string> ipc_env;
+    if (config_.transport == IpcTransport::Tcp) {
+        ipc_env.push_back(fmt::format("CPPCORN_IPC_PORT={}", ipc_port_));
+    } else {
+        ipc_env.push_back("CPPCORN_IPC_PATH=" + ipc_path_);
+        if (config_.transport == IpcTransport::Shm) ipc_env.push_back("CPPCORN_IPC_SHM=1");
+    }
+
+    std::vector<char*> envp;
+    for (char** e = environ; *e; ++e) {
+        if (std::strncmp(*e, "CPPCORN_IPC_", 12) != 0) envp.push_back(*e);
+    }
+    for (auto& var : ipc_env) envp.push_back(var.data());
+    envp.push_back(nullptr);
+
+    std::string python = config_.python;
+    std::string script = config_.script;
+    char* argv[] = {python.data(), script.data(), nullptr};
+
+    pid_t pid;
+    int err = posix_spawnp(&pid, python.c_str(), nullptr, nullptr, argv, envp.data());
+    if (err != 0) {
+        fmt::print("Failed to spawn worker '{} {}': {}\n", python, script, strerror(err));
+        return;
+    }
+    worker_pids_.push_back(pid);
+#endif
+}
+
+void Bridge::reap_workers() {
+    // Collect exited workers so they don't linger as zombies
+#ifdef _WIN32
+    std::erase_if(worker_pids_, [](long long process) {
+        HANDLE h = (HANDLE)(intptr_t)process;
+        if (WaitForSingleObject(h, 0) != WAIT_OBJECT_0) return false;
+        CloseHandle(h);
+        return true;
+    });
+#else
+    std::erase_if(worker_pids_, [](long long pid) {
+        int status;
+        return waitpid((pid_t)pid, &status, WNOHANG) == (pid_t)pid;
+    });
+#endif
+}
+
+core::FireAndForget Bridge::respawn() {
+    // Back off if workers are dying right after start (e.g. the app fails to import)
+    uint64_t since = core::EventLoop::monotonic_ms() - last_spawn_ms_;
+    if (since < 1000) {
+        co_await core::sleep_for(std::chrono::milliseconds(1000 - since));
+    }
+    if (config_.embedded) {
+        fmt::print("Respawning worker\n");
+        spawn_worker(); // Interpreter threads are replaced one for one
+        co_return;
+    }
+    reap_workers();
+    // Replaces the workers that have exited. One that is still on its way
+    // out is left to supervise().
+    while (worker_pids_.size() < (size_t)config_.count) {
+        fmt::print("Respawning worker\n");
+        size_t before = worker_pids_.size();
+        spawn_worker();
+        if (worker_pids_.size() == before) break; // Failed to spawn: try again later
+    }
+}
+
+core::FireAndForget Bridge::supervise() {
+    // Workers that never connect (spawn failed, or exited before connecting)
+    // close no channel, so look for them once a second
+    while (true) {
+        co_await core::sleep_for(std::chrono::milliseconds(1000));
+        reap_workers();
+        if (worker_pids_.size() < (size_t)config_.count) respawn();
+    }
+}
+
+core::FireAndForget Bridge::accept_loop() {
+    while (true) {
+        auto sock = co_await ipc_socket_.accept_async();
+        if (sock.fd() == INVALID_SOCKET_VAL) continue;
+        sock.set_non_blocking();
+
+        auto ch = std::make_unique<Channel>();
+        ch->socket = std::move(sock);
+#ifndef _WIN32
+        if (config_.transport == IpcTransport::Shm) {
+            ch->shm = std::make_unique<ShmTransport>();
+            if (!ch->shm->send_handles(ch->socket)) {
+                fmt::print("Failed to hand shared memory to worker\n");
+                // The worker exits without its rings: replace it
+                respawn();
+                continue;
+            }
+        }
+#endif
+        add_channel(std::move(ch));
+    }
+}
+
+void Bridge::add_channel(std::unique_ptr<Channel> ch) {
+    Channel* raw = ch.get();
+    channels_.push_back(std::move(ch));
+    fmt::print("Worker connected! ({} live)\n", channels_.size());
+#ifndef _WIN32
+    if (raw->interpreter) interpreter_loop(raw);
+    else
+#endif
+    read_loop(raw);
+#ifndef _WIN32
+    if (raw->shm) watch_peer(raw);
+#endif
+
+    wake_waiting();
+}
+
+void Bridge::wake_waiting() {
+    auto waiting = std::move(waiting_);
+    waiting_.clear();
+    for (auto h : waiting) h.resume();
+}
+
+// ----------------------------------------------------------------------------
+// Requests
+// ----------------------------------------------------------------------------
+
+Bridge::Channel* Bridge::pick_channel() {
+    // Least outstanding requests
+    Channel* best = nullptr;
+    for (auto& ch : channels_) {
+        if (!best || ch->pending.size() < best->pending.size()) best = ch.get();
+    }
+    return best;
+}
+
+core::Task<void> Bridge::open(Exchange& ex, const HttpScope& scope, Admission::Permit permit) {
+    uint64_t deadline = core::EventLoop::monotonic_ms() + WORKER_WAIT.count();
+    while (channels_.empty()) {
+        uint64_t now = core::EventLoop::monotonic_ms();
+        if (now >= deadline) {
+            // No worker came up in time: fail like a lost one, with a 502
+            ex.error_ = std::make_exception_ptr(std::runtime_error("No worker available"));
+            ex.done_ = true;
+            if (auto observer = std::exchange(ex.observer_, nullptr)) observer(nullptr, {});
+            co_return;
+        }
+        // Every waiter wakes on a timeout and checks its own deadline
+        co_await core::with_timeout(WorkerAvailable{*this}, std::chrono::milliseconds(deadline - now),
+                                    [this] { wake_waiting(); });
+    }
+    Channel* ch = pick_channel();
+
+    uint32_t id = next_request_id_++;
+    if (id == 0) id = next_request_id_++; // 0 is reserved
+
+    ex.channel_ = ch;
+    ex.id_ = id;
+    ex.opened_us_ = core::EventLoop::monotonic_us();
+    ex.permit_ = std::move(permit);
+    ex.window_ -= std::min(ex.window_, scope.body.size());
+    ex.relaying_ = !scope.more_body;
+    ch->pending[id] = &ex;
+#ifndef _WIN32
+    if (ch->interpreter) {
+        ch->interpreter->to_app.push(EmbeddedEvent::request(scope, id));
+        co_return;
+    }
+#endif
+    Protocol::encode_request_into(ch->out_buf, scope, id);
+    queue_frames(*ch);
+}
+
+void Bridge::queue_frames(Channel& ch) {
+    // Frames are appended to one buffer and written by a single writer, so
+    // concurrent requests never interleave on the socket and frames queued
+    // while a write is in progress go out together.
+    if (!ch.writing) flush_writes(&ch);
+}
+
+Bridge::Exchange::~Exchange() {
+    if (!channel_) return;
+    // Abandoned mid-response (client gone): let the app stop
+    channel_->pending.erase(id_);
+#ifndef _WIN32
+    if (channel_->interpreter) {
+        channel_->interpreter->to_app.push(EmbeddedEvent{MessageType::HTTP_DISCONNECT, id_});
+        return;
+    }
+#endif
+    Protocol::encode_disconnect_into(channel_->out_buf, id_);
+    bridge_.queue_frames(*channel_);
+}
+
+void Bridge::Exchange::wake() {
+    // Take both first: the first resumed may finish the exchange
+    auto waiter = std::exchange(waiter_, nullptr);
+    auto sender = std::exchange(sender_, nullptr);
+    if (waiter) waiter.resume();
+    if (sender) sender.resume();
+}
+
+core::Task<bool> Bridge::Exchange::send_body(std::string_view chunk, bool more_body) {
+    // A chunk larger than the whole window goes out once nothing is in flight
+    while (!done_ && window_ < chunk.size() && window_ < REQUEST_WINDOW) {
+        co_await Signal{sender_};
+    }
+    if (done_ || !channel_) co_return false;
+
+    window_ -= std::min(window_, chunk.size());
+    if (!more_body) relaying_ = true;
+#ifndef _WIN32
+    if (channel_->interpreter) {
+        EmbeddedEvent ev{MessageType::HTTP_REQUEST_BODY, id_};
+        ev.body = chunk;
+        ev.more_body = more_body;
+        channel_->interpreter->to_app.push(std::move(ev));
+        co_return true;
+    }
+#endif
+    Protocol::encode_body_into(channel_->out_buf, chunk, more_body, id_);
+    bridge_.queue_frames(*channel_);
+    co_return true;
+}
+
+core::Task<HttpResponse> Bridge::Exchange::response_start() {
+    relaying_ = true;
+    // Body that arrived while we were still sending the request was credited
+    // straight away; from now on it is credited as it is taken, so a
+    // response queued behind pipelined ones buffers at most a window
+    while (!started_ && !done_) {
+        co_await Signal{waiter_};
+    }
+    if (error_) std::rethrow_exception(error_);
+    // An observer may still need it once the body arrives
+    co_return observer_ ? response_ : std::move(response_);
+}
+
+core::Task<bool> Bridge::Exchange::response_body(std::string& out) {
+    while (body_.empty() && !done_) {
+        co_await Signal{waiter_};
+    }
+    if (error_) std::rethrow_exception(error_);
+
+    out.clear();
+    out.swap(body_);
+    credit(std::exchange(owed_, 0));
+    co_return !done_;
+}
+
+core::Task<bool> Bridge::Exchange::send_message(std::string_view data, bool text) {
+    while (!done_ && window_ < data.size() && window_ < REQUEST_WINDOW) {
+        co_await Signal{sender_};
+    }
+    if (done_ || !channel_) co_return false;
+
+    window_ -= std::min(window_, data.size());
+#ifndef _WIN32
+    if (channel_->interpreter) {
+        EmbeddedEvent ev{MessageType::WEBSOCKET_MESSAGE, id_};
+        ev.body = data;
+        ev.text = text;
+        channel_->interpreter->to_app.push(std::move(ev));
+        co_return true;
+    }
+#endif
+    Protocol::encode_message_into(channel_->out_buf, data, text, id_);
+    bridge_.queue_frames(*channel_);
+    co_return true;
+}
+
+void Bridge::Exchange::send_close(uint16_t code) {
+    if (!channel_) return;
+    channel_->pending.erase(id_);
+#ifndef _WIN32
+    if (channel_->interpreter) {
+        EmbeddedEvent ev{MessageType::WEBSOCKET_CLOSE, id_};
+        ev.code = code;
+        channel_->interpreter->to_app.push(std::move(ev));
+    } else
+#endif
+    {
+        Protocol::encode_close_into(channel_->out_buf, code, {}, id_);
+        bridge_.queue_frames(*channel_);
+    }
+    channel_ = nullptr;
+    done_ = true;
+    wake();
+}
+
+core::Task<bool> Bridge::Exchange::receive_message(WebSocketMessage& out) {
+    while (messages_.empty() && !done_ && !interrupted_) {
+        co_await Signal{waiter_};
+    }
+    if (std::exchange(interrupted_, false)) co_return false;
+    if (messages_.empty()) {
+        if (error_) std::rethrow_exception(error_);
+        co_return false;
+    }
+    out = std::move(messages_.front());
+    messages_.pop_front();
+    credit(out.data.size());
+    co_return true;
+}
+
+void Bridge::Exchange::interrupt() {
+    interrupted_ = true;
+    if (auto h = std::exchange(waiter_, nullptr)) h.resume();
+}
+
+void Bridge::Exchange::credit(size_t bytes) {
+    if (!channel_ || bytes == 0) return;
+#ifndef _WIN32
+    if (channel_->interpreter) {
+        EmbeddedEvent ev{MessageType::HTTP_WINDOW, id_};
+        ev.window = (uint32_t)bytes;
+        channel_->interpreter->to_app.push(std::move(ev));
+        return;
+    }
+#endif
+    Protocol::encode_window_into(channel_->out_buf, (uint32_t)bytes, id_);
+    bridge_.queue_frames(*channel_);
+}
+
+core::FireAndForget Bridge::flush_writes(Channel* ch) {
+    ch->writing = true;
+    std::vector<char> batch;
+    while (!ch->out_buf.empty() && !ch->closed) {
+        batch.clear();
+        batch.swap(ch->out_buf);
+        std::span<const char> data(batch.data(), batch.size());
+        size_t n;
+#ifndef _WIN32
+        if (ch->shm) n = co_await ch->shm->write(data);
+        else
+#endif
+        n = co_await ch->socket.write(data);
+        if (n != batch.size()) {
+            ch->writing = false;
+            close_channel(ch, std::make_exception_ptr(std::runtime_error("IPC Closed")));
+            release_channel(ch);
+            co_return;
+        }
+    }
+    ch->writing = false;
+    if (ch->closed) release_channel(ch);
+}
+
+core::FireAndForget Bridge::read_loop(Channel* ch) {
+    ch->reading = true;
+    std::vector<char> buf(64 * 1024);
+    size_t filled = 0;
+    std::exception_ptr error;
+    try {
+        while (true) {
+            if (filled == buf.size()) buf.resize(buf.size() * 2);
+            std::span<char> space(buf.data() + filled, buf.size() - filled);
+            size_t r;
+#ifndef _WIN32
+            if (ch->shm) r = co_await ch->shm->read(space);
+            else
+#endif
+            r = co_await ch->socket.read(space);
+            if (r == 0) throw std::runtime_error("IPC Closed");
+            filled += r;
+
+            // Dispatch every complete frame in the buffer
+            size_t offset = 0;
+            Message msg;
+            while (size_t used = Protocol::try_decode(std::span<const char>(buf.data() + offset, filled - offset), msg)) {
+                offset += used;
+                dispatch(ch, msg);
+            }
+            if (offset > 0) {
+                std::memmove(buf.data(), buf.data() + offset, filled - offset);
+                filled -= offset;
+            }
+        }
+    } catch (const std::exception& e) {
+        fmt::print("Worker connection lost: {}\n", e.what());
+        error = std::current_exception();
+    }
+    ch->reading = false;
+    close_channel(ch, error);
+    release_channel(ch);
+}
+
+// Applies one frame from the worker to its exchange
+void Bridge::dispatch(Channel* ch, const Message& msg) {
+    auto it = ch->pending.find(msg.request_id);
+    if (it == ch->pending.end()) return; // Caller gone
+    Exchange* ex = it->second;
+
+    switch (msg.type) {
+    case MessageType::HTTP_RESPONSE_START:
+        Protocol::decode_response_start(msg.payload, ex->response_);
+        response_started(ex);
+        return;
+    case MessageType::HTTP_RESPONSE_BODY: {
+        std::string_view body;
+        bool more = Protocol::decode_response_body(msg.payload, body);
+        response_body(ch, ex, body, more);
+        return;
+    }
+    case MessageType::HTTP_WINDOW:
+        ex->window_ += Protocol::decode_window(msg.payload);
+        ex->wake();
+        return;
+    case MessageType::WEBSOCKET_MESSAGE: {
+        std::string_view data;
+        bool text = Protocol::decode_message(msg.payload, data);
+        app_message(ex, data, text);
+        return;
+    }
+    case MessageType::WEBSOCKET_CLOSE: {
+        std::string_view reason;
+        uint16_t code = Protocol::decode_close(msg.payload, reason);
+        app_close(ch, ex, code, reason);
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+void Bridge::response_started(Exchange* ex) {
+    ex->started_ = true;
+    ex->started_us_ = core::EventLoop::monotonic_us();
+    ex->wake();
+}
+
+void Bridge::response_body(Channel* ch, Exchange* ex, std::string_view body, bool more) {
+    if (ex->observer_) {
+        // Before the caller resumes, which may end the exchange
+        auto observer = std::exchange(ex->observer_, nullptr);
+        bool whole = !more && ex->started_;
+        observer(whole ? &ex->response_ : nullptr, whole ? body : std::string_view{});
+    }
+    ex->body_.append(body);
+    if (more) {
+        if (ex->relaying_) {
+            ex->owed_ += body.size();
+        } else {
+            // The caller is still busy with the request body: don't make the
+            // worker wait on it, or a full-duplex app could deadlock
+            ex->credit(body.size());
+        }
+        ex->wake();
+        return;
+    }
+
+    finish(ch, ex);
+}
+
+void Bridge::app_message(Exchange* ex, std::string_view data, bool text) {
+    // Credited as the connection takes it, like a relayed body
+    ex->messages_.push_back({std::string(data), text});
+    ex->wake();
+}
+
+void Bridge::app_close(Channel* ch, Exchange* ex, uint16_t code, std::string_view reason) {
+    ex->close_code_ = code ? code : 1000;
+    ex->close_reason_ = reason;
+    finish(ch, ex);
+}
+
+void Bridge::finish(Channel* ch, Exchange* ex) {
+    ch->pending.erase(ex->id_);
+    ex->channel_ = nullptr;
+    ex->done_ = true;
+    ex->permit_.release(ex->response_time_us());
+    if (auto observer = std::exchange(ex->observer_, nullptr)) observer(nullptr, {});
+    ex->wake();
+}
+
+#ifndef _WIN32
+// The embedded counterpart of read_loop and dispatch: events from an
+// interpreter thread, applied like frames
+core::FireAndForget Bridge::interpreter_loop(Channel* ch) {
+    ch->reading = true;
+    std::vector<EmbeddedEvent> events;
+    bool stopped = false;
+    while (!stopped) {
+        co_await ch->interpreter->to_bridge.bell().wait();
+        ch->interpreter->to_bridge.take(events);
+        for (auto& ev : events) {
+            if (ev.type == MessageType::HTTP_DISCONNECT) stopped = true;
+            else dispatch(ch, ev);
+        }
+    }
+    fmt::print("Interpreter thread stopped\n");
+    ch->reading = false;
+    close_channel(ch, std::make_exception_ptr(std::runtime_error("Interpreter stopped")));
+    release_channel(ch);
+}
+
+void Bridge::dispatch(Channel* ch, EmbeddedEvent& ev) {
+    auto it = ch->pending.find(ev.id);
+    if (it == ch->pending.end()) return; // Caller gone
+    Exchange* ex = it->second;
+
+    switch (ev.type) {
+    case MessageType::HTTP_RESPONSE_START:
+        ex->response_ = std::move(ev.response);
+        response_started(ex);
+        return;
+    case MessageType::HTTP_RESPONSE_BODY:
+        response_body(ch, ex, ev.body, ev.more_body);
+        return;
+    case MessageType::HTTP_WINDOW:
+        ex->window_ += ev.window;
+        ex->wake();
+        return;
+    case MessageType::WEBSOCKET_MESSAGE:
+        app_message(ex, ev.body, ev.text);
+        return;
+    case MessageType::WEBSOCKET_CLOSE:
+        app_close(ch, ex, ev.code, ev.body);
+        return;
+    default:
+        return;
+    }
+}
+#endif
+
+#ifndef _WIN32
+// With shared memory the socket carries no frames; EOF on it means the
+// worker is gone.
+core::FireAndForget Bridge::watch_peer(Channel* ch) {
+    ch->watching = true;
+    char byte;
+    co_await ch->socket.read(std::span(&byte, 1));
+    ch->watching = false;
+    close_channel(ch, std::make_exception_ptr(std::runtime_error("IPC Closed")));
+    release_channel(ch);
+}
+#endif
+
+void Bridge::close_channel(Channel* ch, std::exception_ptr error) {
+    if (ch->closed) return;
+    ch->closed = true;
+    ch->socket.shutdown(); // Wakes the writer if it is parked
+#ifndef _WIN32
+    if (ch->shm) ch->shm->close();
+#endif
+
+    auto it = std::find_if(channels_.begin(), channels_.end(),
+                           [ch](const auto& p) { return p.get() == ch; });
+    if (it != channels_.end()) {
+        retired_.push_back(std::move(*it));
+        channels_.erase(it);
+    }
+
+    // Detach every exchange before resuming anyone: a resumed connection
+    // may destroy its other exchanges, and with them any pointer still
+    // held here. Only the observers and waiting handles are kept.
+    ch->closing = true;
+    auto pending = std::move(ch->pending);
+    ch->pending.clear();
+    std::vector<Exchange::Observer> observers;
+    std::vector<std::coroutine_handle<>> handles;
+    for (auto& [id, ex] : pending) {
+        ex->channel_ = nullptr;
+        ex->error_ = error;
+        ex->done_ = true;
+        ex->permit_.release(0);
+        if (ex->observer_) observers.push_back(std::exchange(ex->observer_, nullptr));
+        if (auto h = std::exchange(ex->waiter_, nullptr)) handles.push_back(h);
+        if (auto h = std::exchange(ex->sender_, nullptr)) handles.push_back(h);
+    }
+    for (auto& observer : observers) observer(nullptr, {});
+    for (auto h : handles) h.resume();
+    ch->closing = false;
+
+    respawn();
+}
+
+void Bridge::release_channel(Channel* ch) {
+    // The caller of close_channel releases it once that returns
+    if (ch->reading || ch->writing || ch->watching || ch->closing) return;
+    std::erase_if(retired_, [ch](const auto& p) { return p.get() == ch; });
 }
 
 } // namespace cppcorn::asgi
@@ -2,26 +2,244 @@
 
 #include "../core/coroutine.hpp"
 #include "../core/socket.hpp"
+#include "shm_transport.hpp"
+#include "embedded.hpp"
+#include "protocol.hpp"
+#include "admission.hpp"
 #include <nlohmann/json.hpp>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+#include <deque>
 
 namespace cppcorn::asgi {
 
+// How workers connect to the bridge. All carry the same framing (protocol.hpp).
+enum class IpcTransport {
+    Tcp,  // Loopback TCP, ephemeral port
+    Unix, // AF_UNIX stream socket in the abstract namespace
+    Shm   // Shared-memory rings, AF_UNIX socket for setup/liveness
+};
+
+// How long a request waits for a worker to connect before failing
+constexpr std::chrono::milliseconds WORKER_WAIT{10000};
+
+struct WorkerConfig {
+    int count = 1;                            // Workers owned by this bridge
+#ifdef _WIN32
+    std::string python = "python";
+#else
+    std::string python = "python3";
+#endif
+    std::string script = "python/worker.py";  // Relative to the working directory
+#ifdef _WIN32
+    IpcTransport transport = IpcTransport::Tcp;
+#else
+    IpcTransport transport = IpcTransport::Unix;
+#endif
+    // Run the app on `count` interpreter threads in this process instead
+    // (embedded.hpp); `script` is then the glue module, python/embedded.py
+    bool embedded = false;
+};
+
+// Owns a pool of Python worker processes for one event loop thread. The
+// bridge spawns the workers itself, accepts their IPC connections (see
+// IpcTransport), and respawns any worker whose connection drops. In embedded
+// mode the workers are interpreter threads, with events instead of frames.
 class Bridge {
 public:
-    Bridge();
+    explicit Bridge(WorkerConfig config = {});
     ~Bridge();
 
-    void listen();
-    void accept_worker(); // Call this to wait for a connection
-    
-    void spawn_worker();
+    // Listens, spawns the workers and starts accepting them. Must be called
+    // on the loop thread that will use this bridge.
+    void start();
+
+private:
+    struct Channel;
+
+public:
+    // One request/response exchange with a worker. Lives in the caller's
+    // frame: open() it with the scope, stream the rest of the body with
+    // send_body(), then relay the response with response_start() and
+    // response_body(). A websocket scope is accepted by a 101 from
+    // response_start(); messages then go both ways with send_message() and
+    // receive_message(), from one coroutine each.
+    class Exchange {
+    public:
+        explicit Exchange(Bridge& bridge) : bridge_(bridge) {}
+        ~Exchange();
+
+        Exchange(const Exchange&) = delete;
+        Exchange& operator=(const Exchange&) = delete;
+
+        // Sends the next piece of the request body, first waiting while the
+        // worker has a full window of unconsumed body. Returns false once
+        // the worker no longer wants it (it responded or went away); the
+        // caller should then drop the rest of the body.
+        core::Task<bool> send_body(std::string_view chunk, bool more_body);
+
+        // Waits for http.response.start. Throws if the worker went away.
+        core::Task<HttpResponse> response_start();
+
+        // Waits for more response body and moves what has arrived into
+        // `out`, returning the worker's credit for it. Returns false once
+        // `out` holds the last of the body. Throws if the worker went away.
+        core::Task<bool> response_body(std::string& out);
+
+        // Called once as the worker's response arrives, however far behind
+        // the caller's relay is: with the response and its whole body if the
+        // body came in one message, otherwise (streamed, or the worker went
+        // away) with null. Not called if the exchange is destroyed first.
+        // Set it before open().
+        using Observer = std::function<void(const HttpResponse* start, std::string_view body)>;
+        void observe(Observer observer) { observer_ = std::move(observer); }
+
+        // True if response_start()/response_body() have something to return
+        // (or an error to throw) without waiting
+        bool ready() const { return done_ || (started_ && !body_.empty()); }
 
-    core::Task<void> send_request(const nlohmann::json& scope);
-    core::Task<nlohmann::json> receive_response();
+        // Microseconds from open() to http.response.start, or 0 if it
+        // hasn't arrived
+        uint64_t response_time_us() const { return started_us_ ? started_us_ - opened_us_ : 0; }
+
+        // Sends a client message to the app, first waiting while a window
+        // of them is unconsumed. Returns false once the app has closed or
+        // gone away.
+        core::Task<bool> send_message(std::string_view data, bool text);
+
+        // Tells the app the client closed (websocket.disconnect with
+        // `code`). Ends the exchange.
+        void send_close(uint16_t code);
+
+        // Waits for the app's next message and moves it into `out`,
+        // returning the worker's credit for it. Returns false without one
+        // once the app has closed (see close_code()), or early after
+        // interrupt(). Throws if the worker went away.
+        core::Task<bool> receive_message(WebSocketMessage& out);
+
+        // Makes a waiting receive_message() return false now
+        void interrupt();
+
+        // websocket.close from the app, once receive_message() returns false
+        bool closed_by_app() const { return close_code_ != 0; }
+        uint16_t close_code() const { return close_code_; }
+        const std::string& close_reason() const { return close_reason_; }
+
+    private:
+        friend class Bridge;
+
+        // Resumed on every window update and on completion. Sending and
+        // receiving wait in separate slots, so a websocket's two directions
+        // can wait at once.
+        struct Signal {
+            std::coroutine_handle<>& slot;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> h) { slot = h; }
+            void await_resume() const noexcept {}
+        };
+        void wake();
+        void credit(size_t bytes);
+
+        Bridge& bridge_;
+        Channel* channel_ = nullptr; // Null once finished
+        uint32_t id_ = 0;
+        size_t window_ = REQUEST_WINDOW;
+        HttpResponse response_;
+        bool started_ = false;   // response_ is valid
+        std::string body_;       // Response body not yet taken
+        std::deque<WebSocketMessage> messages_; // From the app, not yet taken
+        uint16_t close_code_ = 0;
+        std::string close_reason_;
+        bool interrupted_ = false;
+        size_t owed_ = 0;        // Bytes in body_ not yet credited
+        bool relaying_ = false;  // Request fully sent, or response_start() called
+        std::exception_ptr error_;
+        bool done_ = false;      // Response complete, or the worker went away
+        uint64_t opened_us_ = 0;
+        uint64_t started_us_ = 0;
+        Admission::Permit permit_; // Released once the worker is done with us
+        Observer observer_;        // Until the first body message
+        std::coroutine_handle<> waiter_; // In response_*() or receive_message()
+        std::coroutine_handle<> sender_; // In send_body() or send_message()
+    };
+
+    // Sends `scope` (with the body bytes read so far) to the worker with the
+    // fewest requests in flight. Any number of exchanges may be open: each
+    // gets a request id, and one reader coroutine per worker routes frames
+    // back by id. Waits up to WORKER_WAIT if no worker is connected yet,
+    // then fails the exchange as if its worker went away. The scope's views
+    // only need to stay valid until this returns. The exchange holds
+    // `permit` until its response is complete.
+    core::Task<void> open(Exchange& ex, const HttpScope& scope, Admission::Permit permit = {});
 
 private:
+    // One connected worker process
+    struct Channel {
+        core::Socket socket;
+#ifndef _WIN32
+        std::unique_ptr<ShmTransport> shm; // Carries the frames if set
+        std::unique_ptr<Interpreter> interpreter; // Replaces the frames if set
+#endif
+        std::unordered_map<uint32_t, Exchange*> pending;
+        std::vector<char> out_buf;   // Encoded frames waiting to be written
+        bool writing = false;
+        bool reading = false;
+        bool watching = false; // watch_peer running
+        bool closing = false;  // close_channel is resuming its exchanges
+        bool closed = false;
+    };
+
+    struct WorkerAvailable {
+        Bridge& bridge;
+        bool await_ready() const noexcept { return !bridge.channels_.empty(); }
+        void await_suspend(std::coroutine_handle<> h) { bridge.waiting_.push_back(h); }
+        void await_resume() {}
+    };
+
+    Channel* pick_channel();
+    void queue_frames(Channel& ch);
+    void add_channel(std::unique_ptr<Channel> ch);
+    void dispatch(Channel* ch, const Message& msg);
+    void response_started(Exchange* ex);
+    void response_body(Channel* ch, Exchange* ex, std::string_view body, bool more);
+    void app_message(Exchange* ex, std::string_view data, bool text);
+    void app_close(Channel* ch, Exchange* ex, uint16_t code, std::string_view reason);
+    // The worker is done with `ex`
+    void finish(Channel* ch, Exchange* ex);
+    core::FireAndForget flush_writes(Channel* ch);
+    core::FireAndForget read_loop(Channel* ch);
+#ifndef _WIN32
+    void dispatch(Channel* ch, EmbeddedEvent& ev);
+    core::FireAndForget interpreter_loop(Channel* ch);
+#endif
+    core::FireAndForget watch_peer(Channel* ch);
+    core::FireAndForget accept_loop();
+    core::FireAndForget respawn();
+    core::FireAndForget supervise();
+    void wake_waiting();
+    void close_channel(Channel* ch, std::exception_ptr error);
+    void release_channel(Channel* ch);
+
+    void spawn_worker();
+    void reap_workers();
+
+    WorkerConfig config_;
     core::Socket ipc_socket_;     // Listening socket
-    core::Socket worker_socket_;  // Active connection
+    int ipc_port_ = 0;            // Tcp
+    std::string ipc_path_;        // Unix/Shm
+
+    std::vector<std::unique_ptr<Channel>> channels_; // Live workers
+    std::vector<std::unique_ptr<Channel>> retired_;  // Closed, coroutines still finishing
+    std::deque<std::coroutine_handle<>> waiting_; // Calls waiting for a worker
+    std::vector<long long> worker_pids_; // Process handles on Windows
+    uint64_t last_spawn_ms_ = 0;
+
+    uint32_t next_request_id_ = 1;
 };
 
 } // namespace cppcorn::asgi
@@ -0,0 +1,448 @@
+#ifndef _WIN32
+
+#ifdef CPPCORN_EMBED_PYTHON
+#define PY_SSIZE_T_CLEAN
+#include <Python.h> // First: it sets feature macros for the system headers
+#endif
+
+#include "embedded.hpp"
+#include <fmt/core.h>
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+#include <unistd.h>
+
+namespace cppcorn::asgi {
+
+EmbeddedEvent EmbeddedEvent::request(const HttpScope& scope, uint32_t id) {
+    EmbeddedEvent ev{scope.websocket ? MessageType::WEBSOCKET_CONNECT : MessageType::HTTP_REQUEST, id};
+    ev.method = scope.method;
+    ev.target = scope.target;
+    ev.headers.reserve(scope.headers.size());
+    for (const auto& [name, value] : scope.headers) {
+        auto& [lower, copy] = ev.headers.emplace_back(name, value);
+        for (char& c : lower) {
+            if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        }
+    }
+    ev.body = scope.body;
+    ev.more_body = scope.more_body;
+    return ev;
+}
+
+void EmbeddedQueue::push(EmbeddedEvent&& ev) {
+    bool ring;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ring = events_.empty();
+        events_.push_back(std::move(ev));
+    }
+    if (ring) bell_.notify();
+}
+
+void EmbeddedQueue::take(std::vector<EmbeddedEvent>& out) {
+    out.clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.swap(events_); // events_ keeps out's capacity
+}
+
+#ifndef CPPCORN_EMBED_PYTHON
+
+Interpreter::Interpreter(std::string glue) : glue_(std::move(glue)) {
+    throw std::runtime_error("Built without embedded Python (configure with -DCPPCORN_EMBED_PYTHON=ON)");
+}
+
+Interpreter::~Interpreter() {}
+
+void Interpreter::initialize(bool) {
+    throw std::runtime_error("Built without embedded Python (configure with -DCPPCORN_EMBED_PYTHON=ON)");
+}
+
+#else
+
+namespace {
+
+// The interpreter thread the _cppcorn functions are called on
+thread_local Interpreter* current = nullptr;
+bool use_subinterpreters = false;
+
+// Percent-decodes a path for scope["path"]
+std::string unquote(std::string_view s) {
+    auto hex = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        int hi, lo;
+        if (s[i] == '%' && i + 2 < s.size() && (hi = hex(s[i + 1])) >= 0 && (lo = hex(s[i + 2])) >= 0) {
+            out += (char)(hi * 16 + lo);
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+// Built from the parsed request as worker.py's build_scope would
+PyObject* build_scope(const EmbeddedEvent& ev) {
+    std::string_view path = ev.target;
+    std::string_view query = ""; // Not null: y# would make it None
+    if (size_t q = path.find('?'); q != std::string_view::npos) {
+        query = path.substr(q + 1);
+        path = path.substr(0, q);
+    }
+
+    PyObject* headers = PyList_New((Py_ssize_t)ev.headers.size());
+    if (!headers) return nullptr;
+    for (size_t i = 0; i < ev.headers.size(); ++i) {
+        const auto& [name, value] = ev.headers[i];
+        PyObject* pair = Py_BuildValue("(y#y#)", name.data(), (Py_ssize_t)name.size(),
+                                       value.data(), (Py_ssize_t)value.size());
+        if (!pair) {
+            Py_DECREF(headers);
+            return nullptr;
+        }
+        PyList_SET_ITEM(headers, (Py_ssize_t)i, pair);
+    }
+
+    std::string decoded = unquote(path);
+    PyObject* path_str = PyUnicode_DecodeUTF8(decoded.data(), (Py_ssize_t)decoded.size(), "replace");
+    if (!path_str) {
+        Py_DECREF(headers);
+        return nullptr;
+    }
+    return Py_BuildValue("{s:s,s:{s:s,s:s},s:s,s:(si),s:(si),s:s,s:s#,s:N,s:y#,s:y#,s:N}",
+                         "type", "http",
+                         "asgi", "version", "3.0", "spec_version", "2.1",
+                         "http_version", "1.1",
+                         "server", "127.0.0.1", 8000,
+                         "client", "127.0.0.1", 0,
+                         "scheme", "http",
+                         "method", ev.method.data(), (Py_ssize_t)ev.method.size(),
+                         "path", path_str,
+                         "raw_path", path.data(), (Py_ssize_t)path.size(),
+                         "query_string", query.data(), (Py_ssize_t)query.size(),
+                         "headers", headers);
+}
+
+Interpreter* interpreter() {
+    if (!current) PyErr_SetString(PyExc_RuntimeError, "_cppcorn is only usable on CppCorn's interpreter threads");
+    return current;
+}
+
+// Copies a bytes-like object
+bool to_string(PyObject* obj, std::string& out) {
+    Py_buffer view;
+    if (PyObject_GetBuffer(obj, &view, PyBUF_SIMPLE) != 0) return false;
+    out.assign((const char*)view.buf, (size_t)view.len);
+    PyBuffer_Release(&view);
+    return true;
+}
+
+// take() -> [(type, id, ...)]: everything the bridge posted since the last
+// call. HTTP_REQUEST and WEBSOCKET_CONNECT carry (scope, body, more_body),
+// HTTP_REQUEST_BODY (body, more_body), HTTP_WINDOW (bytes),
+// WEBSOCKET_MESSAGE (data, text), WEBSOCKET_CLOSE (code); id 0 with
+// HTTP_DISCONNECT means stop. Websocket scopes come as HTTP ones, for the
+// glue to adjust.
+PyObject* py_take(PyObject*, PyObject*) {
+    Interpreter* self = interpreter();
+    if (!self) return nullptr;
+    uint64_t rings;
+    (void)!::read(self->to_app.bell().fd(), &rings, sizeof(rings)); // Reset before taking
+
+    static thread_local std::vector<EmbeddedEvent> events;
+    self->to_app.take(events);
+    PyObject* list = PyList_New((Py_ssize_t)events.size());
+    if (!list) return nullptr;
+    for (size_t i = 0; i < events.size(); ++i) {
+        const EmbeddedEvent& ev = events[i];
+        PyObject* item = nullptr;
+        switch (ev.type) {
+        case MessageType::HTTP_REQUEST:
+        case MessageType::WEBSOCKET_CONNECT:
+            if (PyObject* scope = build_scope(ev)) {
+                item = Py_BuildValue("(iINy#O)", (int)ev.type, ev.id, scope, ev.body.data(),
+                                     (Py_ssize_t)ev.body.size(), ev.more_body ? Py_True : Py_False);
+            }
+            break;
+        case MessageType::HTTP_REQUEST_BODY:
+            item = Py_BuildValue("(iIy#O)", (int)ev.type, ev.id, ev.body.data(),
+                                 (Py_ssize_t)ev.body.size(), ev.more_body ? Py_True : Py_False);
+            break;
+        case MessageType::HTTP_WINDOW:
+            item = Py_BuildValue("(iII)", (int)ev.type, ev.id, ev.window);
+            break;
+        case MessageType::WEBSOCKET_MESSAGE:
+            item = Py_BuildValue("(iIy#O)", (int)ev.type, ev.id, ev.body.data(),
+                                 (Py_ssize_t)ev.body.size(), ev.text ? Py_True : Py_False);
+            break;
+        case MessageType::WEBSOCKET_CLOSE:
+            item = Py_BuildValue("(iIi)", (int)ev.type, ev.id, (int)ev.code);
+            break;
+        default:
+            item = Py_BuildValue("(iI)", (int)ev.type, ev.id);
+            break;
+        }
+        if (!item) {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        PyList_SET_ITEM(list, (Py_ssize_t)i, item);
+    }
+    events.clear();
+    return list;
+}
+
+// start(id, status, headers): http.response.start
+PyObject* py_start(PyObject*, PyObject* args) {
+    unsigned int id;
+    int status;
+    PyObject* headers;
+    if (!PyArg_ParseTuple(args, "IiO", &id, &status, &headers)) return nullptr;
+    Interpreter* self = interpreter();
+    if (!self) return nullptr;
+
+    EmbeddedEvent ev{MessageType::HTTP_RESPONSE_START};
+    ev.id = id;
+    ev.response.status = status;
+    PyObject* seq = PySequence_Fast(headers, "headers must be a sequence");
+    if (!seq) return nullptr;
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    ev.response.headers.resize((size_t)n);
+    for (Py_ssize_t i = 0; i < n; ++i) {
+        PyObject* pair = PySequence_Fast(PySequence_Fast_GET_ITEM(seq, i), "header must be a pair");
+        bool ok = pair && PySequence_Fast_GET_SIZE(pair) == 2 &&
+                  to_string(PySequence_Fast_GET_ITEM(pair, 0), ev.response.headers[i].first) &&
+                  to_string(PySequence_Fast_GET_ITEM(pair, 1), ev.response.headers[i].second);
+        Py_XDECREF(pair);
+        if (!ok) {
+            if (!PyErr_Occurred()) PyErr_SetString(PyExc_TypeError, "header must be a pair of bytes");
+            Py_DECREF(seq);
+            return nullptr;
+        }
+    }
+    Py_DECREF(seq);
+    self->to_bridge.push(std::move(ev));
+    Py_RETURN_NONE;
+}
+
+// body(id, data, more_body): http.response.body
+PyObject* py_body(PyObject*, PyObject* args) {
+    unsigned int id;
+    Py_buffer data;
+    int more;
+    if (!PyArg_ParseTuple(args, "Iy*p", &id, &data, &more)) return nullptr;
+    Interpreter* self = interpreter();
+    if (!self) {
+        PyBuffer_Release(&data);
+        return nullptr;
+    }
+    EmbeddedEvent ev{MessageType::HTTP_RESPONSE_BODY};
+    ev.id = id;
+    ev.body.assign((const char*)data.buf, (size_t)data.len);
+    ev.more_body = more != 0;
+    PyBuffer_Release(&data);
+    self->to_bridge.push(std::move(ev));
+    Py_RETURN_NONE;
+}
+
+// window(id, bytes): request body the app has received
+PyObject* py_window(PyObject*, PyObject* args) {
+    unsigned int id, bytes;
+    if (!PyArg_ParseTuple(args, "II", &id, &bytes)) return nullptr;
+    Interpreter* self = interpreter();
+    if (!self) return nullptr;
+    EmbeddedEvent ev{MessageType::HTTP_WINDOW};
+    ev.id = id;
+    ev.window = bytes;
+    self->to_bridge.push(std::move(ev));
+    Py_RETURN_NONE;
+}
+
+// message(id, data, text): websocket.send
+PyObject* py_message(PyObject*, PyObject* args) {
+    unsigned int id;
+    Py_buffer data;
+    int text;
+    if (!PyArg_ParseTuple(args, "Iy*p", &id, &data, &text)) return nullptr;
+    Interpreter* self = interpreter();
+    if (!self) {
+        PyBuffer_Release(&data);
+        return nullptr;
+    }
+    EmbeddedEvent ev{MessageType::WEBSOCKET_MESSAGE, id};
+    ev.body.assign((const char*)data.buf, (size_t)data.len);
+    ev.text = text != 0;
+    PyBuffer_Release(&data);
+    self->to_bridge.push(std::move(ev));
+    Py_RETURN_NONE;
+}
+
+// close(id, code, reason): websocket.close once accepted
+PyObject* py_close(PyObject*, PyObject* args) {
+    unsigned int id;
+    int code;
+    Py_buffer reason;
+    if (!PyArg_ParseTuple(args, "Iiy*", &id, &code, &reason)) return nullptr;
+    Interpreter* self = interpreter();
+    if (!self) {
+        PyBuffer_Release(&reason);
+        return nullptr;
+    }
+    EmbeddedEvent ev{MessageType::WEBSOCKET_CLOSE, id};
+    ev.code = (uint16_t)code;
+    ev.body.assign((const char*)reason.buf, (size_t)reason.len);
+    PyBuffer_Release(&reason);
+    self->to_bridge.push(std::move(ev));
+    Py_RETURN_NONE;
+}
+
+// fileno(): readable when take() has something
+PyObject* py_fileno(PyObject*, PyObject*) {
+    Interpreter* self = interpreter();
+    if (!self) return nullptr;
+    return PyLong_FromLong(self->to_app.bell().fd());
+}
+
+PyMethodDef methods[] = {
+    {"take", py_take, METH_NOARGS, "Takes the events posted by the bridge"},
+    {"start", py_start, METH_VARARGS, "Sends http.response.start"},
+    {"body", py_body, METH_VARARGS, "Sends http.response.body"},
+    {"window", py_window, METH_VARARGS, "Credits request body the app received"},
+    {"message", py_message, METH_VARARGS, "Sends websocket.send"},
+    {"close", py_close, METH_VARARGS, "Sends websocket.close"},
+    {"fileno", py_fileno, METH_NOARGS, "Doorbell fd, readable when events are waiting"},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+// Multi-phase init, so each subinterpreter gets its own module object
+PyModuleDef_Slot slots[] = {
+#if PY_VERSION_HEX >= 0x030C0000
+    {Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+#if PY_VERSION_HEX >= 0x030D0000
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+    {0, nullptr},
+};
+
+PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT, "_cppcorn", "CppCorn's side of embedded ASGI (python/embedded.py)",
+    0, methods, slots, nullptr, nullptr, nullptr,
+};
+
+PyObject* init_module() {
+    return PyModuleDef_Init(&module_def);
+}
+
+// Imports the glue module by path and runs its serve() until told to stop
+void serve(const std::string& glue) {
+    std::filesystem::path path = std::filesystem::absolute(glue);
+    std::string dir = path.parent_path().string();
+    std::string name = path.stem().string();
+
+    PyObject* sys_path = PySys_GetObject("path"); // Borrowed
+    PyObject* entry = PyUnicode_FromString(dir.c_str());
+    if (sys_path && entry && PySequence_Contains(sys_path, entry) == 0) PyList_Insert(sys_path, 0, entry);
+    Py_XDECREF(entry);
+
+    PyObject* module = PyImport_ImportModule(name.c_str());
+    if (!module) {
+        PyErr_Print();
+        return;
+    }
+    PyObject* result = PyObject_CallMethod(module, "serve", nullptr);
+    if (!result) PyErr_Print();
+    Py_XDECREF(result);
+    Py_DECREF(module);
+}
+
+} // namespace
+
+Interpreter::Interpreter(std::string glue) : glue_(std::move(glue)) {
+    thread_ = std::thread([this] { run(); });
+}
+
+Interpreter::~Interpreter() {
+    to_app.push(EmbeddedEvent{MessageType::HTTP_DISCONNECT, 0});
+    if (thread_.joinable()) thread_.join();
+}
+
+void Interpreter::run() {
+    PyGILState_STATE gil = PyGILState_Ensure();
+#if PY_VERSION_HEX >= 0x030C0000 && !defined(Py_GIL_DISABLED)
+    PyThreadState* main_state = nullptr;
+    PyThreadState* sub = nullptr;
+    if (use_subinterpreters) {
+        main_state = PyThreadState_Get();
+        PyInterpreterConfig config = {
+            .use_main_obmalloc = 0,
+            .allow_fork = 0,
+            .allow_exec = 0,
+            .allow_threads = 1,
+            .allow_daemon_threads = 0,
+            .check_multi_interp_extensions = 1,
+            .gil = PyInterpreterConfig_OWN_GIL,
+        };
+        // Switches this thread to the new interpreter, holding its GIL
+        PyStatus status = Py_NewInterpreterFromConfig(&sub, &config);
+        if (PyStatus_Exception(status)) {
+            fmt::print("Failed to create a subinterpreter: {}\n", status.err_msg ? status.err_msg : "unknown");
+            sub = nullptr;
+        }
+    }
+#endif
+
+    current = this;
+    serve(glue_);
+    current = nullptr;
+
+#if PY_VERSION_HEX >= 0x030C0000 && !defined(Py_GIL_DISABLED)
+    if (sub) {
+        Py_EndInterpreter(sub);
+        PyEval_RestoreThread(main_state);
+    }
+#endif
+    PyGILState_Release(gil);
+    to_bridge.push(EmbeddedEvent{MessageType::HTTP_DISCONNECT, 0}); // We're gone
+}
+
+void Interpreter::initialize(bool subinterpreters) {
+    use_subinterpreters = subinterpreters;
+    if (PyImport_AppendInittab("_cppcorn", init_module) != 0) {
+        throw std::runtime_error("Failed to register the _cppcorn module");
+    }
+
+    PyConfig config;
+    PyConfig_InitPythonConfig(&config);
+    config.install_signal_handlers = 0; // Signals stay ours
+    PyStatus status = Py_InitializeFromConfig(&config);
+    PyConfig_Clear(&config);
+    if (PyStatus_Exception(status)) {
+        throw std::runtime_error(fmt::format("Failed to initialise Python: {}",
+                                             status.err_msg ? status.err_msg : "unknown"));
+    }
+
+#if defined(Py_GIL_DISABLED)
+    const char* mode = "free-threaded";
+#elif PY_VERSION_HEX >= 0x030C0000
+    const char* mode = subinterpreters ? "a subinterpreter with its own GIL per thread" : "shared GIL";
+#else
+    use_subinterpreters = false;
+    const char* mode = "shared GIL";
+#endif
+    fmt::print("Embedded Python {} ({})\n", PY_VERSION, mode);
+    PyEval_SaveThread(); // Interpreter threads take the GIL as they need it
+}
+
+#endif
+
+} // namespace cppcorn::asgi
+
+#endif
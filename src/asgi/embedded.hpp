@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include "protocol.hpp"
+#include "../core/eventfd.hpp"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cppcorn::asgi {
+
+// One request-level event between a bridge and an embedded interpreter. The
+// types mean what they do in the IPC protocol (protocol.hpp), but nothing is
+// encoded: the interpreter builds the ASGI scope straight from these fields.
+struct EmbeddedEvent {
+    EmbeddedEvent(MessageType type, uint32_t id = 0) : type(type), id(id) {}
+
+    MessageType type;
+    uint32_t id;             // 0 with HTTP_DISCONNECT: the interpreter stops/stopped
+    std::string method;      // HTTP_REQUEST, WEBSOCKET_CONNECT
+    std::string target;      // path?query as received
+    HeaderList headers;      // Names lowercased
+    std::string body;        // Body bytes, message payload or close reason
+    bool more_body = false;
+    HttpResponse response;   // HTTP_RESPONSE_START
+    uint32_t window = 0;     // HTTP_WINDOW
+    bool text = false;       // WEBSOCKET_MESSAGE
+    uint16_t code = 0;       // WEBSOCKET_CLOSE
+
+    // HTTP_REQUEST (or WEBSOCKET_CONNECT) for `scope`, copied out of the
+    // parser's buffers
+    static EmbeddedEvent request(const HttpScope& scope, uint32_t id);
+};
+
+// Multi-producer queue of events with an eventfd doorbell. The doorbell is
+// rung when the queue turns non-empty; the consumer resets it before taking
+// everything queued.
+class EmbeddedQueue {
+public:
+    void push(EmbeddedEvent&& ev);
+    void take(std::vector<EmbeddedEvent>& out);
+    core::EventFd& bell() { return bell_; }
+
+private:
+    std::mutex mutex_;
+    std::vector<EmbeddedEvent> events_;
+    core::EventFd bell_;
+};
+
+// One thread running the ASGI app through the glue module (python/embedded.py)
+// on its own asyncio loop. The owning bridge posts requests to `to_app`; the
+// app's responses come back on `to_bridge`, ending with an HTTP_DISCONNECT
+// for id 0 if the thread stops (e.g. the app failed to import).
+//
+// By default the threads share the main interpreter and its GIL (none on
+// free-threaded builds), which still takes the IPC hops out of every
+// request. On 3.12+ each thread can instead get a subinterpreter with its
+// own GIL, if every extension module the app imports supports that.
+class Interpreter {
+public:
+    explicit Interpreter(std::string glue);
+    ~Interpreter(); // Stops the app's loop and joins the thread
+
+    Interpreter(const Interpreter&) = delete;
+    Interpreter& operator=(const Interpreter&) = delete;
+
+    EmbeddedQueue to_app;
+    EmbeddedQueue to_bridge;
+
+    // Initialises CPython for the process. Call once on the main thread
+    // before any bridge starts; `subinterpreters` = true gives each thread
+    // its own (3.12+). Throws if built without CPPCORN_EMBED_PYTHON.
+    static void initialize(bool subinterpreters);
+
+private:
+    void run();
+
+    std::string glue_; // Path of python/embedded.py
+    std::thread thread_;
+};
+
+} // namespace cppcorn::asgi
+
+#endif
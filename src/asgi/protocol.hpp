@@ -3,63 +3,294 @@
 #include <cstdint>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <span>
+#include <utility>
+#include <cstring>
+#include <stdexcept>
 #include <nlohmann/json.hpp>
 
 namespace cppcorn::asgi {
 
 enum class MessageType : uint8_t {
     JSON = 1,
-    BINARY = 2 // For optimization later (e.g. file descriptors or raw bytes)
+    HTTP_REQUEST = 2,        // Bridge -> worker: binary HTTP scope and first body bytes
+    HTTP_RESPONSE_START = 3, // Worker -> bridge: status and headers
+    HTTP_RESPONSE_BODY = 4,  // Worker -> bridge: [u8 more_body][body bytes]
+    HTTP_REQUEST_BODY = 5,   // Bridge -> worker: [u8 more_body][body bytes]
+    HTTP_WINDOW = 6,         // Either way: [u32 body bytes consumed by the receiver]
+    HTTP_DISCONNECT = 7,     // Bridge -> worker: the client went away (no payload)
+    WEBSOCKET_CONNECT = 8,   // Bridge -> worker: a websocket scope, laid out as HTTP_REQUEST
+    WEBSOCKET_MESSAGE = 9,   // Either way: [u8 text][payload bytes]
+    WEBSOCKET_CLOSE = 10     // Either way: [u16 code][reason bytes]
 };
 
-// Protocol: [4 bytes Length (Big Endian or host? Host is faster for local IPC)][1 byte Type][Payload]
+// Protocol: [4 bytes Length (Big Endian or host? Host is faster for local IPC)][1 byte Type][4 bytes Request ID][Payload]
 // Let's use Host Endian for IPC on same machine, assuming same endianness (safe for UDS/Loopback).
+// Length counts everything after itself (type + request id + payload).
+// The request id ties a response to its request, so many requests can be in
+// flight on one worker connection at once.
+//
+// Binary payloads use the same host-endian integers. Strings are length
+// prefixed: s16 = [u16 len][bytes], s32 = [u32 len][bytes].
+//   HTTP_REQUEST:        s16 method, s32 raw path, s32 query string,
+//                        u16 header count, (s16 name, s32 value)*,
+//                        u8 more_body, s32 body
+//   HTTP_REQUEST_BODY,
+//   HTTP_RESPONSE_BODY:  u8 more_body, body bytes (rest of the frame)
+//   HTTP_RESPONSE_START: u16 status, u16 header count, (s16 name, s32 value)*
+//   HTTP_WINDOW:         u32 bytes
+//   WEBSOCKET_MESSAGE:   u8 text, payload bytes (rest of the frame)
+//   WEBSOCKET_CLOSE:     u16 code, reason bytes (rest of the frame)
+// Header names are lowercased by the bridge, as ASGI expects.
+//
+// Bodies are flow controlled in both directions. The bridge keeps at most
+// REQUEST_WINDOW request body bytes in flight per request, and the worker
+// returns credit with HTTP_WINDOW as the app receive()s them. The worker
+// keeps at most RESPONSE_WINDOW response body bytes in flight, and the
+// bridge returns credit as the connection writes them out.
+//
+// A websocket starts with WEBSOCKET_CONNECT. The worker answers with
+// HTTP_RESPONSE_START: 101 accepts (its headers join the handshake), any
+// other status denies, and the denial's body follows as HTTP_RESPONSE_BODY.
+// Messages then flow both ways under the same windows as bodies, until
+// either side sends WEBSOCKET_CLOSE. Pings and the close handshake with the
+// client never reach the worker.
+
+constexpr size_t HEADER_SIZE = sizeof(uint32_t) + 1 + sizeof(uint32_t);
+constexpr size_t REQUEST_WINDOW = 64 * 1024;
+constexpr size_t RESPONSE_WINDOW = 256 * 1024;
+
+using HeaderList = std::vector<std::pair<std::string, std::string>>;
+
+// The parts of a request the worker needs; views into the parsed request
+struct HttpScope {
+    std::string_view method;
+    std::string_view target; // path?query as received
+    std::span<const std::pair<std::string_view, std::string_view>> headers;
+    std::string_view body;   // Body bytes available so far
+    bool more_body = false;  // Rest follows via HTTP_REQUEST_BODY
+    bool websocket = false;  // Sent as WEBSOCKET_CONNECT
+};
+
+// http.response.start; the body streams separately
+struct HttpResponse {
+    int status = 200;
+    HeaderList headers;
+};
+
+// websocket.send / websocket.receive
+struct WebSocketMessage {
+    std::string data;
+    bool text = false;
+};
 
 struct Message {
     MessageType type;
-    nlohmann::json data;
-    // std::vector<char> binary_data; // If mixed
+    uint32_t request_id = 0;
+    nlohmann::json data;            // JSON messages
+    std::span<const char> payload;  // Binary messages; points into the decode buffer
 };
 
 class Protocol {
 public:
-    static std::vector<char> encode(const nlohmann::json& payload) {
-        std::string s = payload.dump();
-        uint32_t len = s.size() + 1; // +1 for type
-        
-        std::vector<char> buffer(sizeof(uint32_t) + 1 + s.size());
-        
-        // Header
-        std::memcpy(buffer.data(), &len, sizeof(len));
-        buffer[sizeof(uint32_t)] = (uint8_t)MessageType::JSON;
-        
-        // Payload
-        std::memcpy(buffer.data() + sizeof(uint32_t) + 1, s.data(), s.size());
-        
+    static std::vector<char> encode(const nlohmann::json& payload, uint32_t request_id) {
+        std::vector<char> buffer;
+        encode_into(buffer, payload, request_id);
         return buffer;
     }
 
+    // Appends one frame to `out` (lets callers batch several frames per write)
+    static void encode_into(std::vector<char>& out, const nlohmann::json& payload, uint32_t request_id) {
+        std::string s = payload.dump();
+        size_t base = begin_frame(out, MessageType::JSON, request_id);
+        out.insert(out.end(), s.begin(), s.end());
+        end_frame(out, base);
+    }
+
+    // Appends one HTTP_REQUEST frame to `out`
+    static void encode_request_into(std::vector<char>& out, const HttpScope& scope, uint32_t request_id) {
+        std::string_view path = scope.target;
+        std::string_view query;
+        if (size_t q = path.find('?'); q != std::string_view::npos) {
+            query = path.substr(q + 1);
+            path = path.substr(0, q);
+        }
+
+        size_t base = begin_frame(out, scope.websocket ? MessageType::WEBSOCKET_CONNECT
+                                                       : MessageType::HTTP_REQUEST, request_id);
+        put_string<uint16_t>(out, scope.method);
+        put_string<uint32_t>(out, path);
+        put_string<uint32_t>(out, query);
+        put<uint16_t>(out, (uint16_t)scope.headers.size());
+        for (const auto& [name, value] : scope.headers) {
+            size_t at = out.size() + sizeof(uint16_t);
+            put_string<uint16_t>(out, name);
+            for (size_t i = at; i < out.size(); ++i) {
+                char c = out[i];
+                if (c >= 'A' && c <= 'Z') out[i] = c + ('a' - 'A');
+            }
+            put_string<uint32_t>(out, value);
+        }
+        put<uint8_t>(out, scope.more_body ? 1 : 0);
+        put_string<uint32_t>(out, scope.body);
+        end_frame(out, base);
+    }
+
+    // Appends one HTTP_REQUEST_BODY frame to `out`
+    static void encode_body_into(std::vector<char>& out, std::string_view body, bool more_body, uint32_t request_id) {
+        size_t base = begin_frame(out, MessageType::HTTP_REQUEST_BODY, request_id);
+        put<uint8_t>(out, more_body ? 1 : 0);
+        out.insert(out.end(), body.begin(), body.end());
+        end_frame(out, base);
+    }
+
+    // Appends one HTTP_WINDOW frame to `out`
+    static void encode_window_into(std::vector<char>& out, uint32_t bytes, uint32_t request_id) {
+        size_t base = begin_frame(out, MessageType::HTTP_WINDOW, request_id);
+        put<uint32_t>(out, bytes);
+        end_frame(out, base);
+    }
+
+    // Appends one HTTP_DISCONNECT frame to `out`
+    static void encode_disconnect_into(std::vector<char>& out, uint32_t request_id) {
+        end_frame(out, begin_frame(out, MessageType::HTTP_DISCONNECT, request_id));
+    }
+
+    // Appends one WEBSOCKET_MESSAGE frame to `out`
+    static void encode_message_into(std::vector<char>& out, std::string_view data, bool text, uint32_t request_id) {
+        size_t base = begin_frame(out, MessageType::WEBSOCKET_MESSAGE, request_id);
+        put<uint8_t>(out, text ? 1 : 0);
+        out.insert(out.end(), data.begin(), data.end());
+        end_frame(out, base);
+    }
+
+    // Appends one WEBSOCKET_CLOSE frame to `out`
+    static void encode_close_into(std::vector<char>& out, uint16_t code, std::string_view reason, uint32_t request_id) {
+        size_t base = begin_frame(out, MessageType::WEBSOCKET_CLOSE, request_id);
+        put<uint16_t>(out, code);
+        out.insert(out.end(), reason.begin(), reason.end());
+        end_frame(out, base);
+    }
+
+    // HTTP_WINDOW payload
+    static uint32_t decode_window(std::span<const char> payload) {
+        return Reader{payload}.get<uint32_t>();
+    }
+
+    // HTTP_RESPONSE_START payload
+    static void decode_response_start(std::span<const char> payload, HttpResponse& out) {
+        Reader r{payload};
+        out.status = r.get<uint16_t>();
+        uint16_t count = r.get<uint16_t>();
+        out.headers.clear();
+        out.headers.reserve(count);
+        for (uint16_t i = 0; i < count; ++i) {
+            std::string_view name = r.get_string<uint16_t>();
+            std::string_view value = r.get_string<uint32_t>();
+            out.headers.emplace_back(name, value);
+        }
+    }
+
+    // HTTP_RESPONSE_BODY payload. Returns more_body.
+    static bool decode_response_body(std::span<const char> payload, std::string_view& body) {
+        if (payload.empty()) throw std::runtime_error("IPC body frame too short");
+        body = std::string_view(payload.data() + 1, payload.size() - 1);
+        return payload[0] != 0;
+    }
+
+    // WEBSOCKET_MESSAGE payload. Returns whether it is text.
+    static bool decode_message(std::span<const char> payload, std::string_view& data) {
+        if (payload.empty()) throw std::runtime_error("IPC message frame too short");
+        data = std::string_view(payload.data() + 1, payload.size() - 1);
+        return payload[0] != 0;
+    }
+
+    // WEBSOCKET_CLOSE payload. Returns the close code.
+    static uint16_t decode_close(std::span<const char> payload, std::string_view& reason) {
+        Reader r{payload};
+        uint16_t code = r.get<uint16_t>();
+        reason = std::string_view(payload.data() + r.pos, payload.size() - r.pos);
+        return code;
+    }
+
     // Returns number of bytes consumed if full message, else 0
     static size_t try_decode(std::span<const char> buffer, Message& out_msg) {
-        if (buffer.size() < sizeof(uint32_t) + 1) return 0;
+        if (buffer.size() < HEADER_SIZE) return 0;
         
         uint32_t len;
         std::memcpy(&len, buffer.data(), sizeof(len));
+        if (len < HEADER_SIZE - sizeof(uint32_t)) {
+            throw std::runtime_error("IPC frame too short");
+        }
         
         if (buffer.size() < sizeof(uint32_t) + len) {
             return 0; // Incomplete
         }
         
         uint8_t type = buffer[sizeof(uint32_t)];
-        if (type == (uint8_t)MessageType::JSON) {
-            out_msg.type = MessageType::JSON;
-            std::string_view sv(buffer.data() + sizeof(uint32_t) + 1, len - 1);
+        std::memcpy(&out_msg.request_id, buffer.data() + sizeof(uint32_t) + 1, sizeof(uint32_t));
+        out_msg.type = (MessageType)type;
+        out_msg.payload = buffer.subspan(HEADER_SIZE, sizeof(uint32_t) + len - HEADER_SIZE);
+        if (out_msg.type == MessageType::JSON) {
+            std::string_view sv(out_msg.payload.data(), out_msg.payload.size());
             out_msg.data = nlohmann::json::parse(sv);
         }
         
         return sizeof(uint32_t) + len;
     }
+
+private:
+    // Writes a header with a placeholder length; end_frame fills it in
+    static size_t begin_frame(std::vector<char>& out, MessageType type, uint32_t request_id) {
+        size_t base = out.size();
+        out.resize(base + HEADER_SIZE);
+        char* p = out.data() + base;
+        p[sizeof(uint32_t)] = (char)type;
+        std::memcpy(p + sizeof(uint32_t) + 1, &request_id, sizeof(request_id));
+        return base;
+    }
+
+    static void end_frame(std::vector<char>& out, size_t base) {
+        uint32_t len = (uint32_t)(out.size() - base - sizeof(uint32_t));
+        std::memcpy(out.data() + base, &len, sizeof(len));
+    }
+
+    template <typename T>
+    static void put(std::vector<char>& out, T value) {
+        size_t at = out.size();
+        out.resize(at + sizeof(T));
+        std::memcpy(out.data() + at, &value, sizeof(T));
+    }
+
+    template <typename Len>
+    static void put_string(std::vector<char>& out, std::string_view s) {
+        put<Len>(out, (Len)s.size());
+        out.insert(out.end(), s.begin(), s.end());
+    }
+
+    struct Reader {
+        std::span<const char> data;
+        size_t pos = 0;
+
+        template <typename T>
+        T get() {
+            if (data.size() - pos < sizeof(T)) throw std::runtime_error("IPC payload truncated");
+            T value;
+            std::memcpy(&value, data.data() + pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
+        }
+
+        template <typename Len>
+        std::string_view get_string() {
+            size_t n = get<Len>();
+            if (data.size() - pos < n) throw std::runtime_error("IPC payload truncated");
+            std::string_view s(data.data() + pos, n);
+            pos += n;
+            return s;
+        }
+    };
 };
 
 } // namespace cppcorn::asgi
@@ -0,0 +1,144 @@
+#ifndef _WIN32
+
+#include "shm_transport.hpp"
+#include "../core/timeout.hpp"
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace cppcorn::asgi {
+
+// ----------------------------------------------------------------------------
+// ShmRing
+// ----------------------------------------------------------------------------
+
+ShmRing::ShmRing(void* base, size_t capacity)
+    : header_(static_cast<Header*>(base)),
+      data_(static_cast<char*>(base) + sizeof(Header)),
+      capacity_(capacity) {
+}
+
+size_t ShmRing::write(std::span<const char> data) {
+    uint64_t head = header_->head.load(std::memory_order_acquire);
+    uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+    size_t n = std::min(data.size(), capacity_ - (size_t)(tail - head));
+    if (n == 0) return 0;
+
+    size_t start = tail & (capacity_ - 1);
+    size_t first = std::min(n, capacity_ - start);
+    std::memcpy(data_ + start, data.data(), first);
+    std::memcpy(data_, data.data() + first, n - first);
+
+    header_->tail.store(tail + n, std::memory_order_release);
+    return n;
+}
+
+size_t ShmRing::read(std::span<char> out, size_t& used_before) {
+    uint64_t tail = header_->tail.load(std::memory_order_acquire);
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    used_before = (size_t)(tail - head);
+    size_t n = std::min(out.size(), used_before);
+    if (n == 0) return 0;
+
+    size_t start = head & (capacity_ - 1);
+    size_t first = std::min(n, capacity_ - start);
+    std::memcpy(out.data(), data_ + start, first);
+    std::memcpy(out.data() + first, data_, n - first);
+
+    header_->head.store(head + n, std::memory_order_release);
+    return n;
+}
+
+// ----------------------------------------------------------------------------
+// ShmTransport
+// ----------------------------------------------------------------------------
+
+// Layout: [to_worker header][to_worker data][from_worker header][from_worker data]
+ShmTransport::ShmTransport() {
+    constexpr size_t ring_bytes = sizeof(ShmRing::Header) + RING_SIZE;
+    mapped_ = 2 * ring_bytes;
+
+    memfd_ = memfd_create("cppcorn-ipc", MFD_CLOEXEC);
+    if (memfd_ < 0 || ftruncate(memfd_, (off_t)mapped_) < 0) {
+        if (memfd_ >= 0) ::close(memfd_);
+        throw std::runtime_error("Failed to create IPC shared memory");
+    }
+    base_ = mmap(nullptr, mapped_, PROT_READ | PROT_WRITE, MAP_SHARED, memfd_, 0);
+    if (base_ == MAP_FAILED) {
+        ::close(memfd_);
+        throw std::runtime_error("Failed to map IPC shared memory");
+    }
+
+    // A fresh memfd is zero-filled, so both rings start empty
+    to_worker_ = ShmRing(base_, RING_SIZE);
+    from_worker_ = ShmRing(static_cast<char*>(base_) + ring_bytes, RING_SIZE);
+}
+
+ShmTransport::~ShmTransport() {
+    munmap(base_, mapped_);
+    ::close(memfd_);
+}
+
+bool ShmTransport::send_handles(const core::Socket& control) {
+    int fds[4] = {memfd_, worker_bell_.fd(), data_bell_.fd(), space_bell_.fd()};
+    uint64_t ring_size = RING_SIZE;
+
+    iovec iov{&ring_size, sizeof(ring_size)};
+    alignas(cmsghdr) char control_buf[CMSG_SPACE(sizeof(fds))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control_buf;
+    msg.msg_controllen = sizeof(control_buf);
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    // A fresh socket's buffer always has room for this
+    return sendmsg(control.fd(), &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(ring_size);
+}
+
+core::Task<size_t> ShmTransport::read(std::span<char> buffer) {
+    while (true) {
+        size_t used_before;
+        size_t n = from_worker_.read(buffer, used_before);
+        if (n > 0) {
+            if (used_before >= RING_SIZE / 2) worker_bell_.notify();
+            co_return n;
+        }
+        if (closed_) co_return 0;
+        co_await data_bell_.wait();
+    }
+}
+
+core::Task<size_t> ShmTransport::write(std::span<const char> buffer) {
+    using namespace std::chrono_literals;
+    size_t written = 0;
+    while (written < buffer.size() && !closed_) {
+        size_t n = to_worker_.write(buffer.subspan(written));
+        if (n > 0) {
+            written += n;
+            worker_bell_.notify();
+            continue;
+        }
+        co_await core::with_timeout(space_bell_.wait(), 1ms, [this] { space_bell_.notify(); });
+    }
+    co_return written;
+}
+
+void ShmTransport::close() {
+    if (closed_) return;
+    closed_ = true;
+    data_bell_.notify();
+    space_bell_.notify();
+}
+
+} // namespace cppcorn::asgi
+
+#endif
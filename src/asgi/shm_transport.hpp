@@ -0,0 +1,90 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include "../core/coroutine.hpp"
+#include "../core/eventfd.hpp"
+#include "../core/socket.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace cppcorn::asgi {
+
+// Single-producer/single-consumer byte ring in shared memory. Positions are
+// free-running byte counts, so used = tail - head; the data area follows the
+// header and its size is a power of two.
+class ShmRing {
+public:
+    struct Header {
+        alignas(64) std::atomic<uint64_t> head; // Advanced by the consumer
+        alignas(64) std::atomic<uint64_t> tail; // Advanced by the producer
+    };
+    static_assert(sizeof(Header) == 128);
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+    ShmRing() = default;
+    ShmRing(void* base, size_t capacity);
+
+    // Producer: copies as much of `data` as fits, returns the bytes copied.
+    size_t write(std::span<const char> data);
+    // Consumer: copies out up to `out.size()` bytes. `used_before` receives
+    // the fill level seen before reading.
+    size_t read(std::span<char> out, size_t& used_before);
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    Header* header_ = nullptr;
+    char* data_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+// Bridge <-> worker transport over a pair of shared-memory rings, with
+// eventfd doorbells for wakeups. The worker still connects over an AF_UNIX
+// socket; that socket carries the memfd and eventfds (SCM_RIGHTS) and then
+// only signals that the peer went away.
+//
+// Data doorbells are rung once per written batch. A consumer rings the
+// "space" doorbell only after draining a ring that was at least half full,
+// and a producer blocked on a full ring re-checks every millisecond in case
+// it raced with that.
+class ShmTransport {
+public:
+    static constexpr size_t RING_SIZE = 1 << 20; // Per direction
+
+    ShmTransport();
+    ~ShmTransport();
+
+    ShmTransport(const ShmTransport&) = delete;
+    ShmTransport& operator=(const ShmTransport&) = delete;
+
+    // Hands the mapping and doorbells to the worker on `control`
+    bool send_handles(const core::Socket& control);
+
+    // Same contract as Socket::read/write: read resumes with at least one
+    // byte, or 0 once closed; write resumes with the bytes written, short
+    // only if closed.
+    core::Task<size_t> read(std::span<char> buffer);
+    core::Task<size_t> write(std::span<const char> buffer);
+
+    // Fails pending and future I/O
+    void close();
+
+private:
+    int memfd_ = -1;
+    void* base_ = nullptr;
+    size_t mapped_ = 0;
+
+    ShmRing to_worker_;
+    ShmRing from_worker_;
+    core::EventFd worker_bell_; // Worker waits: requests or space to respond
+    core::EventFd data_bell_;   // We wait: responses available
+    core::EventFd space_bell_;  // We wait: request ring drained
+    bool closed_ = false;
+};
+
+} // namespace cppcorn::asgi
+
+#endif
@@ -3,6 +3,7 @@
 #include <coroutine>
 #include <exception>
 #include <variant>
+#include "frame_pool.hpp"
 
 namespace cppcorn::core {
 
@@ -12,7 +13,7 @@ public:
     struct promise_type;
     using handle_type = std::coroutine_handle<promise_type>;
 
-    struct promise_type {
+    struct promise_type : PooledFrame {
         T value;
         std::exception_ptr exception;
 
@@ -22,13 +23,17 @@ public:
 
         std::suspend_always initial_suspend() { return {}; }
 
+        // Symmetric transfer: jump straight to the awaiting coroutine
+        // instead of resuming it from inside this frame, so long await
+        // chains don't grow the native stack.
         struct FinalAwaitable {
             bool await_ready() const noexcept { return false; }
-            void await_suspend(handle_type h) noexcept {
+            std::coroutine_handle<> await_suspend(handle_type h) noexcept {
                 auto continuation = h.promise().continuation;
                 if (continuation) {
-                    continuation.resume();
+                    return continuation;
                 }
+                return std::noop_coroutine();
             }
             void await_resume() noexcept {}
         };
@@ -69,9 +74,9 @@ public:
 
     bool await_ready() const { return handle.done(); }
 
-    void await_suspend(std::coroutine_handle<> continuation) {
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) {
         handle.promise().continuation = continuation;
-        handle.resume();
+        return handle;
     }
 
     T await_resume() {
@@ -92,7 +97,7 @@ public:
     struct promise_type;
     using handle_type = std::coroutine_handle<promise_type>;
 
-    struct promise_type {
+    struct promise_type : PooledFrame {
         std::exception_ptr exception;
 
         Task get_return_object() {
@@ -103,11 +108,12 @@ public:
 
         struct FinalAwaitable {
             bool await_ready() const noexcept { return false; }
-            void await_suspend(handle_type h) noexcept {
+            std::coroutine_handle<> await_suspend(handle_type h) noexcept {
                 auto continuation = h.promise().continuation;
                 if (continuation) {
-                    continuation.resume();
+                    return continuation;
                 }
+                return std::noop_coroutine();
             }
             void await_resume() noexcept {}
         };
@@ -144,9 +150,9 @@ public:
 
     bool await_ready() const { return handle.done(); }
 
-    void await_suspend(std::coroutine_handle<> continuation) {
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) {
         handle.promise().continuation = continuation;
-        handle.resume();
+        return handle;
     }
 
     void await_resume() {
@@ -161,7 +167,7 @@ private:
 
 // Fire and forget task (detached)
 struct FireAndForget {
-    struct promise_type {
+    struct promise_type : PooledFrame {
         FireAndForget get_return_object() { return {}; }
         std::suspend_never initial_suspend() { return {}; }
         std::suspend_never final_suspend() noexcept { return {}; }
@@ -1,14 +1,26 @@
 #include "event_loop.hpp"
 #include <fmt/core.h>
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
 
 namespace cppcorn::core {
 
 EventLoop& EventLoop::instance() {
-    static EventLoop loop;
+    static thread_local EventLoop loop;
     return loop;
 }
 
+uint64_t EventLoop::monotonic_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t EventLoop::monotonic_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
 #ifdef _WIN32
 // ============================================================================
 // Windows IOCP Implementation
@@ -33,6 +45,10 @@ EventLoop::~EventLoop() {
     WSACleanup();
 }
 
+void EventLoop::unregister_handle(NativeSocket) {
+    // Closing the socket drops its IOCP association
+}
+
 void EventLoop::register_handle(NativeSocket fd) {
     // Use 0 as completion key since we rely on OVERLAPPED pointer for context
     if (CreateIoCompletionPort((HANDLE)fd, iocp_handle_, 0, 0) == NULL) {
@@ -52,17 +68,19 @@ void EventLoop::run() {
     LPOVERLAPPED overlapped;
 
     while (running_) {
+        int64_t timeout = timers_.next_timeout();
         BOOL ok = GetQueuedCompletionStatus(
             iocp_handle_,
             &bytes_transferred,
             &completion_key,
             &overlapped,
-            INFINITE
+            timeout < 0 ? INFINITE : (DWORD)timeout
         );
 
         if (!overlapped) {
-            // General error or exit signal (if we posted one)
+            // General error, timeout or exit signal (if we posted one)
             if (GetLastError() == ERROR_ABANDONED_WAIT_0) break;
+            timers_.advance(monotonic_ms());
             continue;
         }
 
@@ -77,6 +95,7 @@ void EventLoop::run() {
             op->success = ok;
             op->handle.resume();
         }
+        timers_.advance(monotonic_ms());
     }
 }
 
@@ -90,8 +109,32 @@ void EventLoop::stop() {
 // Linux Epoll Implementation
 // ============================================================================
 
+static IoBackend g_default_backend = IoBackend::Epoll;
+
+// Tag bit on user_data marking a multishot accept completion (UringAcceptor*)
+// rather than a one-shot UringOperation*.
+static constexpr uint64_t ACCEPT_TAG = 1;
+// user_data of the IORING_OP_TIMEOUT that bounds the wait for the next timer
+static constexpr uint64_t TIMEOUT_USER_DATA = 2;
+
+void EventLoop::set_default_backend(IoBackend backend) {
+    g_default_backend = backend;
+}
+
 EventLoop::EventLoop() {
-    epoll_fd_ = epoll_create1(0);
+    if (g_default_backend == IoBackend::IoUring) {
+        try {
+            uring_ = std::make_unique<Uring>(4096);
+            if (!uring_->setup_buffer_ring(0, 1024, 8192)) {
+                fmt::print("io_uring: provided buffer rings unavailable, reading into caller buffers\n");
+            }
+            return;
+        } catch (const std::exception& e) {
+            fmt::print("io_uring unavailable ({}), falling back to epoll\n", e.what());
+        }
+    }
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
     if (epoll_fd_ < 0) {
         throw std::runtime_error("Failed to create epoll fd");
     }
@@ -101,12 +144,47 @@ EventLoop::~EventLoop() {
     if (epoll_fd_ >= 0) close(epoll_fd_);
 }
 
+EventLoop::FdContext& EventLoop::context(int fd) {
+    if ((size_t)fd >= fds_.size()) {
+        fds_.resize(std::max<size_t>(fd + 1, fds_.size() * 2));
+    }
+    return fds_[fd];
+}
+
 void EventLoop::register_handle(NativeSocket fd) {
-    // No-op for readiness model until we add interest (add_reader/writer)
-    // But we might want to track it
+    if (uring_) return;
+
+    auto& ctx = context(fd);
+    if (ctx.registered) return;
+
+    // Registered once for both directions; edge-triggered so an idle but
+    // writable socket doesn't keep waking us up.
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0 && errno != EEXIST) {
+        throw std::runtime_error(fmt::format("Failed to add fd {} to epoll: {}", fd, errno));
+    }
+    ctx.registered = true;
+}
+
+void EventLoop::unregister_handle(NativeSocket fd) {
+    if (uring_ || fd < 0 || (size_t)fd >= fds_.size()) return;
+
+    auto& ctx = fds_[fd];
+    if (ctx.registered) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    // The fd number will be reused, start clean
+    ctx = FdContext{};
 }
 
 void EventLoop::run() {
+    if (uring_) {
+        run_uring();
+        return;
+    }
+
     running_ = true;
     const int MAX_EVENTS = 64;
     struct epoll_event events[MAX_EVENTS];
@@ -114,71 +192,131 @@ void EventLoop::run() {
     fmt::print("EventLoop (Epoll) started.\n");
 
     while (running_) {
-        int nfds = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        int nfds = epoll_wait(epoll_fd_, events, MAX_EVENTS, (int)timers_.next_timeout());
         if (nfds < 0) {
             if (errno == EINTR) continue;
             break;
         }
 
         for (int i = 0; i < nfds; ++i) {
-            int fd = events[i].data.fd; // Simplified
-            auto it = fd_map_.find(fd);
-            if (it == fd_map_.end()) continue;
-
-            if (events[i].events & EPOLLIN) {
-                if (it->second.read_handle) {
-                    auto h = it->second.read_handle;
-                    it->second.read_handle = nullptr;
-                    h.resume();
-                }
+            int fd = events[i].data.fd;
+            uint32_t mask = events[i].events;
+            if ((size_t)fd >= fds_.size()) continue;
+
+            // Errors and hangups wake both sides so they observe the failure.
+            // Re-index after each resume: the coroutine may register new fds.
+            if (mask & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                wake(fd, &FdContext::reader);
             }
-            if (events[i].events & EPOLLOUT) {
-                if (it->second.write_handle) {
-                    auto h = it->second.write_handle;
-                    it->second.write_handle = nullptr;
+            if (mask & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+                wake(fd, &FdContext::writer);
+            }
+        }
+
+        timers_.advance(monotonic_ms());
+    }
+}
+
+void EventLoop::wake(int fd, IoWaiter* FdContext::* slot) {
+    IoWaiter* w = fds_[fd].*slot;
+    if (!w) return;
+    if (w->try_complete && !w->try_complete(w)) return; // Still EAGAIN, stay parked
+    fds_[fd].*slot = nullptr;
+    w->handle.resume();
+}
+
+void EventLoop::run_uring() {
+    running_ = true;
+    fmt::print("EventLoop (io_uring) started.\n");
+
+    io_uring_cqe cqe;
+    while (running_) {
+        // Bound the wait by the next timer. A timeout SQE is only added when
+        // none is armed or the armed one fires too late.
+        int64_t timeout = timers_.next_timeout();
+        if (timeout >= 0) {
+            uint64_t at = timers_.now() + timeout;
+            if (uring_timeout_at_ == 0 || at < uring_timeout_at_) {
+                uring_timeout_.tv_sec = timeout / 1000;
+                uring_timeout_.tv_nsec = (timeout % 1000) * 1000000;
+                io_uring_sqe* sqe = uring_->get_sqe();
+                sqe->opcode = IORING_OP_TIMEOUT;
+                sqe->addr = reinterpret_cast<uint64_t>(&uring_timeout_);
+                sqe->len = 1;
+                sqe->user_data = TIMEOUT_USER_DATA;
+                uring_timeout_at_ = at;
+            }
+        }
+
+        // One syscall submits everything queued since the last pass and waits
+        uring_->submit_and_wait(1);
+
+        while (uring_->next_cqe(cqe)) {
+            if (cqe.user_data == TIMEOUT_USER_DATA) {
+                uring_timeout_at_ = 0;
+                continue;
+            }
+            if (cqe.user_data & ACCEPT_TAG) {
+                auto* acc = reinterpret_cast<UringAcceptor*>(cqe.user_data & ~ACCEPT_TAG);
+                acc->ready.push_back(cqe.res);
+                if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                    acc->armed = false;
+                }
+                if (acc->waiter) {
+                    auto h = acc->waiter;
+                    acc->waiter = nullptr;
                     h.resume();
                 }
+                continue;
+            }
+
+            auto* op = reinterpret_cast<UringOperation*>(cqe.user_data);
+            if (op && op->handle) {
+                op->result = cqe.res;
+                op->flags = cqe.flags;
+                if (op->try_complete && !op->try_complete(op)) continue; // Resubmitted
+                op->handle.resume();
             }
         }
+
+        timers_.advance(monotonic_ms());
     }
 }
 
+UringAcceptor& EventLoop::acceptor(int listen_fd) {
+    return acceptors_[listen_fd];
+}
+
+void EventLoop::arm_accept(int listen_fd, UringAcceptor& acceptor) {
+    io_uring_sqe* sqe = uring_->get_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = reinterpret_cast<uint64_t>(&acceptor) | ACCEPT_TAG;
+    acceptor.armed = true;
+}
+
 void EventLoop::stop() {
     running_ = false;
 }
 
-void EventLoop::add_reader(int fd, std::coroutine_handle<> handle) {
-    auto& ctx = fd_map_[fd];
-    ctx.read_handle = handle;
-
-    struct epoll_event ev;
-    ev.events = EPOLLIN | EPOLLONESHOT;
-    ev.data.fd = fd;
-    
-    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
-         epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
-    }
+void EventLoop::add_reader(int fd, IoWaiter* waiter) {
+    register_handle(fd);
+    fds_[fd].reader = waiter;
 }
 
 void EventLoop::remove_reader(int fd) {
-    if (fd_map_.count(fd)) fd_map_[fd].read_handle = nullptr;
+    if ((size_t)fd < fds_.size()) fds_[fd].reader = nullptr;
 }
 
-void EventLoop::add_writer(int fd, std::coroutine_handle<> handle) {
-    auto& ctx = fd_map_[fd];
-    ctx.write_handle = handle;
-
-    struct epoll_event ev;
-    ev.events = EPOLLOUT | EPOLLONESHOT;
-    ev.data.fd = fd;
-
-    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
-        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
-    }
+void EventLoop::add_writer(int fd, IoWaiter* waiter) {
+    register_handle(fd);
+    fds_[fd].writer = waiter;
 }
 
 void EventLoop::remove_writer(int fd) {
-    if (fd_map_.count(fd)) fd_map_[fd].write_handle = nullptr;
+    if ((size_t)fd < fds_.size()) fds_[fd].writer = nullptr;
 }
 
 #endif
@@ -1,11 +1,17 @@
 #pragma once
 
 #include "platform.hpp"
+#include "timer.hpp"
 #include <functional>
 #include <vector>
 #include <memory>
 #include <coroutine>
 #include <unordered_map>
+#include <deque>
+
+#ifndef _WIN32
+#include "uring.hpp"
+#endif
 
 namespace cppcorn::core {
 
@@ -23,10 +29,43 @@ struct IocpOperation {
         success = false;
     }
 };
+#else
+// An operation parked on fd readiness (epoll). When the fd turns ready the
+// loop calls try_complete, if set, to retry the syscall; it returns false on
+// a spurious EAGAIN and the waiter stays parked. Otherwise `handle` resumes.
+struct IoWaiter {
+    std::coroutine_handle<> handle;
+    bool (*try_complete)(IoWaiter*) = nullptr;
+};
+
+// Linux io_uring: the SQE's user_data points at one of these. try_complete,
+// if set, sees the completion first and may resubmit (return false) instead
+// of resuming `handle`.
+struct UringOperation {
+    std::coroutine_handle<> handle;
+    int result = 0;      // cqe->res
+    uint32_t flags = 0;  // cqe->flags
+    bool (*try_complete)(UringOperation*) = nullptr;
+    void* context = nullptr;
+};
+
+// Multishot accept state for one listening socket
+struct UringAcceptor {
+    std::deque<int> ready;  // Accepted fds (or -errno) not yet taken
+    std::coroutine_handle<> waiter;
+    bool armed = false;
+};
+
+enum class IoBackend {
+    Epoll,
+    IoUring
+};
 #endif
 
 class EventLoop {
 public:
+    // Returns the calling thread's loop. Each thread lazily gets its own
+    // instance, so one loop per thread can run side by side.
     static EventLoop& instance();
 
     EventLoop();
@@ -35,32 +74,65 @@ public:
     void run();
     void stop();
 
+    // Timers are advanced after every wait; the wait itself is bounded by
+    // the next due timer. Use sleep_for/with_timeout (timeout.hpp) rather
+    // than scheduling nodes directly.
+    TimerWheel& timers() { return timers_; }
+    static uint64_t monotonic_ms();
+    static uint64_t monotonic_us(); // For latency measurements
+
     // Common Interface
     void register_handle(NativeSocket fd);
+    void unregister_handle(NativeSocket fd); // Call before closing fd
 
 #ifdef _WIN32
     // Windows Specific: No explicit add_reader/add_writer. Logic is in Socket.
     HANDLE iocp_handle() const { return iocp_handle_; }
 #else
-    // Linux Specific: Reactor pattern registration
-    void add_reader(int fd, std::coroutine_handle<> handle);
+    // Linux Specific: Reactor pattern registration. An fd is added to epoll
+    // once (edge-triggered, in and out); these only park the waiter.
+    // Callers must have seen EAGAIN before parking.
+    void add_reader(int fd, IoWaiter* waiter);
     void remove_reader(int fd);
-    void add_writer(int fd, std::coroutine_handle<> handle);
+    void add_writer(int fd, IoWaiter* waiter);
     void remove_writer(int fd);
+
+    // Backend for loops constructed afterwards. io_uring falls back to epoll
+    // if the kernel refuses to set up a ring.
+    static void set_default_backend(IoBackend backend);
+    IoBackend backend() const { return uring_ ? IoBackend::IoUring : IoBackend::Epoll; }
+
+    // io_uring backend only
+    Uring& uring() { return *uring_; }
+    UringAcceptor& acceptor(int listen_fd);
+    void arm_accept(int listen_fd, UringAcceptor& acceptor);
 #endif
 
 private:
     bool running_ = false;
+    TimerWheel timers_{monotonic_ms()};
 
 #ifdef _WIN32
     HANDLE iocp_handle_ = NULL;
 #else
     int epoll_fd_ = -1;
     struct FdContext {
-        std::coroutine_handle<> read_handle;
-        std::coroutine_handle<> write_handle;
+        IoWaiter* reader = nullptr;
+        IoWaiter* writer = nullptr;
+        bool registered = false;
     };
-    std::unordered_map<int, FdContext> fd_map_;
+    void wake(int fd, IoWaiter* FdContext::* slot);
+    // Indexed by fd (fds are small and dense)
+    std::vector<FdContext> fds_;
+
+    FdContext& context(int fd);
+
+    void run_uring();
+
+    std::unique_ptr<Uring> uring_;
+    std::unordered_map<int, UringAcceptor> acceptors_;
+    __kernel_timespec uring_timeout_{};
+    uint64_t uring_timeout_at_ = 0; // Wheel time the armed timeout SQE fires, 0 if none
 #endif
 };
 
@@ -0,0 +1,82 @@
+#ifndef _WIN32
+
+#include "eventfd.hpp"
+#include <sys/eventfd.h>
+#include <stdexcept>
+#include <utility>
+
+namespace cppcorn::core {
+
+EventFd::EventFd() {
+    fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to create eventfd");
+    }
+}
+
+EventFd::~EventFd() {
+    close();
+}
+
+EventFd::EventFd(EventFd&& other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+
+EventFd& EventFd::operator=(EventFd&& other) noexcept {
+    if (this != &other) {
+        close();
+        fd_ = std::exchange(other.fd_, -1);
+    }
+    return *this;
+}
+
+void EventFd::close() {
+    if (fd_ >= 0) {
+        EventLoop::instance().unregister_handle(fd_);
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void EventFd::notify() {
+    uint64_t one = 1;
+    // Only fails if the counter would overflow, which still leaves it readable
+    (void)!::write(fd_, &one, sizeof(one));
+}
+
+EventFd::WaitOp EventFd::wait() {
+    return WaitOp(EventLoop::instance(), fd_);
+}
+
+bool EventFd::WaitOp::attempt() {
+    ssize_t r = ::read(fd, &value, sizeof(value));
+    return !(r < 0 && is_would_block());
+}
+
+bool EventFd::WaitOp::await_ready() {
+    if (loop.backend() == IoBackend::IoUring) return false;
+    return attempt();
+}
+
+void EventFd::WaitOp::await_suspend(std::coroutine_handle<> h) {
+    if (loop.backend() == IoBackend::IoUring) {
+        uop.handle = h;
+        io_uring_sqe* sqe = loop.uring().get_sqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&value);
+        sqe->len = sizeof(value);
+        sqe->off = (uint64_t)-1;
+        sqe->user_data = reinterpret_cast<uint64_t>(&uop);
+        return;
+    }
+    handle = h;
+    try_complete = &retry;
+    loop.add_reader(fd, this);
+}
+
+bool EventFd::WaitOp::retry(IoWaiter* w) {
+    return static_cast<WaitOp*>(w)->attempt();
+}
+
+} // namespace cppcorn::core
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include "event_loop.hpp"
+#include <cstdint>
+
+namespace cppcorn::core {
+
+// Non-blocking eventfd used as a doorbell, possibly shared with another
+// process. notify() bumps the counter; co_await wait() resumes once it is
+// non-zero and resets it.
+class EventFd {
+public:
+    EventFd();
+    ~EventFd();
+
+    EventFd(EventFd&& other) noexcept;
+    EventFd& operator=(EventFd&& other) noexcept;
+
+    EventFd(const EventFd&) = delete;
+    EventFd& operator=(const EventFd&) = delete;
+
+    int fd() const { return fd_; }
+    void notify();
+    void close();
+
+    // Same shape as Socket::ReadOp: the read is attempted in await_ready and
+    // only EAGAIN parks the coroutine. On io_uring a read SQE is submitted.
+    struct WaitOp : IoWaiter {
+        EventLoop& loop;
+        int fd;
+        uint64_t value = 0;
+        UringOperation uop;
+
+        WaitOp(EventLoop& l, int f) : loop(l), fd(f) {}
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> h);
+        void await_resume() const noexcept {}
+
+    private:
+        bool attempt();
+        static bool retry(IoWaiter* w);
+    };
+
+    WaitOp wait();
+
+private:
+    int fd_ = -1;
+};
+
+} // namespace cppcorn::core
+
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace cppcorn::core {
+
+struct FramePoolStats {
+    uint64_t hits = 0;     // Served from a free list
+    uint64_t misses = 0;   // Free list empty, went to operator new
+    uint64_t oversize = 0; // Larger than the biggest size class
+};
+
+// Per-thread free lists for coroutine frames, in 64-byte size classes up to
+// 4 KB. Frames freed on another thread simply join that thread's lists, so
+// no locking is needed. Each class caches a bounded number of blocks.
+class FramePool {
+public:
+    static constexpr size_t GRANULE = 64;
+    static constexpr size_t CLASSES = 64;
+    static constexpr size_t MAX_SIZE = GRANULE * CLASSES;
+    static constexpr size_t MAX_CACHED = 1024;
+
+    static FramePool& local() {
+        static thread_local FramePool pool;
+        return pool;
+    }
+
+    ~FramePool() {
+        // Frames destroyed later during thread teardown bypass the lists
+        closed_ = true;
+        for (auto& list : free_) {
+            while (list.head) {
+                Block* b = list.head;
+                list.head = b->next;
+                ::operator delete(b);
+            }
+            list.count = 0;
+        }
+    }
+
+    void* allocate(size_t size) {
+        if (size > MAX_SIZE) {
+            ++stats_.oversize;
+            return ::operator new(size);
+        }
+        FreeList& list = free_[size_class(size)];
+        if (Block* b = list.head) {
+            list.head = b->next;
+            --list.count;
+            ++stats_.hits;
+            return b;
+        }
+        ++stats_.misses;
+        return ::operator new((size_class(size) + 1) * GRANULE);
+    }
+
+    void deallocate(void* p, size_t size) noexcept {
+        if (size > MAX_SIZE || closed_) {
+            ::operator delete(p);
+            return;
+        }
+        FreeList& list = free_[size_class(size)];
+        if (list.count >= MAX_CACHED) {
+            ::operator delete(p);
+            return;
+        }
+        Block* b = static_cast<Block*>(p);
+        b->next = list.head;
+        list.head = b;
+        ++list.count;
+    }
+
+    const FramePoolStats& stats() const { return stats_; }
+
+private:
+    struct Block {
+        Block* next;
+    };
+    struct FreeList {
+        Block* head = nullptr;
+        size_t count = 0;
+    };
+
+    static size_t size_class(size_t size) {
+        return size == 0 ? 0 : (size - 1) / GRANULE;
+    }
+
+    FreeList free_[CLASSES];
+    FramePoolStats stats_;
+    bool closed_ = false;
+};
+
+// Mixed into promise types so coroutine frames come from the FramePool
+struct PooledFrame {
+    static void* operator new(size_t size) {
+        return FramePool::local().allocate(size);
+    }
+    static void operator delete(void* p, size_t size) noexcept {
+        FramePool::local().deallocate(p, size);
+    }
+};
+
+} // namespace cppcorn::core
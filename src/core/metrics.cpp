@@ -0,0 +1,107 @@
+#include "metrics.hpp"
+#include <fmt/format.h>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cppcorn::core {
+
+// Metrics outlive their threads, so totals never go backwards
+static std::mutex g_registry_mutex;
+static std::vector<std::unique_ptr<Metrics>> g_registry;
+
+Metrics& Metrics::local() {
+    thread_local Metrics* metrics = [] {
+        std::lock_guard<std::mutex> lock(g_registry_mutex);
+        return g_registry.emplace_back(std::make_unique<Metrics>()).get();
+    }();
+    return *metrics;
+}
+
+namespace {
+
+struct Writer {
+    std::string out;
+    std::vector<const Metrics*> threads;
+
+    void header(std::string_view name, std::string_view type, std::string_view help) {
+        fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+    }
+
+    template <typename Get>
+    void scalar(std::string_view name, std::string_view type, std::string_view help, Get get) {
+        header(name, type, help);
+        int64_t total = 0;
+        for (const Metrics* m : threads) total += (int64_t)get(*m);
+        fmt::format_to(std::back_inserter(out), "{} {}\n", name, total);
+    }
+
+    void histogram(std::string_view name, std::string_view help, Histogram Metrics::*field) {
+        header(name, "histogram", help);
+        uint64_t cumulative = 0, sum_us = 0;
+        for (int k = 0; k < Histogram::BUCKETS; ++k) {
+            for (const Metrics* m : threads) cumulative += (m->*field).bucket(k);
+            if (k == Histogram::BUCKETS - 1) {
+                fmt::format_to(std::back_inserter(out), "{}_bucket{{le=\"+Inf\"}} {}\n", name, cumulative);
+            } else {
+                fmt::format_to(std::back_inserter(out), "{}_bucket{{le=\"{}\"}} {}\n", name,
+                               (double)(1ull << k) / 1e6, cumulative);
+            }
+        }
+        for (const Metrics* m : threads) sum_us += (m->*field).sum_us();
+        fmt::format_to(std::back_inserter(out), "{}_sum {}\n{}_count {}\n", name, (double)sum_us / 1e6,
+                       name, cumulative);
+    }
+};
+
+} // namespace
+
+std::string Metrics::render() {
+    Writer w;
+    {
+        std::lock_guard<std::mutex> lock(g_registry_mutex);
+        for (const auto& m : g_registry) w.threads.push_back(m.get());
+    }
+
+    w.scalar("cppcorn_connections_accepted_total", "counter", "Connections accepted.",
+             [](const Metrics& m) { return m.connections_accepted.value(); });
+    w.scalar("cppcorn_connections_active", "gauge", "Connections currently open.",
+             [](const Metrics& m) { return m.connections_active.value(); });
+    w.scalar("cppcorn_requests_total", "counter", "Requests received.",
+             [](const Metrics& m) { return m.requests.value(); });
+    w.scalar("cppcorn_received_bytes_total", "counter", "Bytes read from clients.",
+             [](const Metrics& m) { return m.bytes_in.value(); });
+    w.scalar("cppcorn_sent_bytes_total", "counter", "Bytes written to clients.",
+             [](const Metrics& m) { return m.bytes_out.value(); });
+
+    static constexpr const char* kinds[] = {"parse", "timeout", "shed", "worker", "connection"};
+    static_assert(std::size(kinds) == (size_t)ErrorKind::Count);
+    w.header("cppcorn_errors_total", "counter",
+             "Malformed requests, read timeouts, shed requests, worker failures and dropped connections.");
+    for (size_t i = 0; i < std::size(kinds); ++i) {
+        uint64_t total = 0;
+        for (const Metrics* m : w.threads) total += m->errors[i].value();
+        fmt::format_to(std::back_inserter(w.out), "cppcorn_errors_total{{kind=\"{}\"}} {}\n", kinds[i], total);
+    }
+
+    w.scalar("cppcorn_access_log_dropped_total", "counter", "Access log records dropped on a full ring.",
+             [](const Metrics& m) { return m.access_log_dropped.value(); });
+
+    w.histogram("cppcorn_parse_seconds", "Time parsing each request's headers.", &Metrics::parse_us);
+    w.histogram("cppcorn_queue_wait_seconds", "Time requests waited for admission and a worker.",
+                &Metrics::queue_wait_us);
+    w.histogram("cppcorn_worker_response_seconds", "Time from forwarding a request to its response start.",
+                &Metrics::worker_us);
+    w.histogram("cppcorn_write_seconds", "Time per socket write.", &Metrics::write_us);
+
+    w.scalar("cppcorn_admission_limit", "gauge", "Adaptive limit on requests in flight to workers.",
+             [](const Metrics& m) { return m.admission_limit.value(); });
+    w.scalar("cppcorn_admission_in_flight", "gauge", "Requests holding an admission slot.",
+             [](const Metrics& m) { return m.admission_in_flight.value(); });
+    w.scalar("cppcorn_admission_queued", "gauge", "Requests waiting for an admission slot.",
+             [](const Metrics& m) { return m.admission_queued.value(); });
+    return std::move(w.out);
+}
+
+} // namespace cppcorn::core
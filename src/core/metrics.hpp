@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <string>
+
+namespace cppcorn::core {
+
+// Only the owning thread writes a metric, so updates are plain relaxed
+// load/store pairs (no locked instructions); any thread may read.
+class Counter {
+public:
+    void add(uint64_t n = 1) {
+        value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class Gauge {
+public:
+    void add(int64_t n) {
+        value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// Latencies in microseconds, bucketed by powers of two: bucket k counts
+// values in (2^(k-1), 2^k] us, up to 2^26 us (~67 s); the last is overflow.
+class Histogram {
+public:
+    static constexpr int BUCKETS = 28;
+
+    void record(uint64_t us) {
+        int k = us <= 1 ? 0 : (int)std::bit_width(us - 1);
+        buckets_[k < BUCKETS - 1 ? k : BUCKETS - 1].add();
+        sum_us_.add(us);
+    }
+    uint64_t bucket(int k) const { return buckets_[k].value(); }
+    uint64_t sum_us() const { return sum_us_.value(); }
+
+private:
+    std::array<Counter, BUCKETS> buckets_;
+    Counter sum_us_;
+};
+
+enum class ErrorKind { Parse, Timeout, Shed, Worker, Connection, Count };
+
+// One loop thread's metrics. Threads register theirs on first use and the
+// scrape sums them; nothing is shared on the hot path.
+struct Metrics {
+    Counter connections_accepted;
+    Gauge connections_active;
+    Counter requests;
+    Counter bytes_in;
+    Counter bytes_out;
+    std::array<Counter, (size_t)ErrorKind::Count> errors;
+    Counter access_log_dropped;
+
+    Histogram parse_us;      // Parser time for a request's headers
+    Histogram queue_wait_us; // Admission queue plus waiting for a worker
+    Histogram worker_us;     // Request sent to http.response.start
+    Histogram write_us;      // Each socket write (batch or file)
+
+    Gauge admission_limit;
+    Gauge admission_in_flight;
+    Gauge admission_queued;
+
+    void error(ErrorKind kind) { errors[(size_t)kind].add(); }
+
+    // The calling thread's metrics
+    static Metrics& local();
+    // All threads' metrics, summed, in Prometheus text format
+    static std::string render();
+};
+
+} // namespace cppcorn::core
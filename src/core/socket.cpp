@@ -2,6 +2,16 @@
 #include <stdexcept>
 #include <system_error>
 #include <fmt/core.h>
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/un.h>
+#include <sys/sendfile.h>
+#include <poll.h>
+#include <netinet/tcp.h>
+#include <climits>
+#endif
 
 namespace cppcorn::core {
 
@@ -17,9 +27,35 @@ static struct WinsockInit {
 } winsock_init;
 #endif
 
+std::span<char> ReadBuffer::own() {
+    if (own_.empty()) own_.resize(OWN_BYTES);
+    return own_;
+}
+
+void ReadBuffer::lend(Uring& ring, uint16_t bid) {
+#ifndef _WIN32
+    ring_ = &ring;
+    bid_ = bid;
+    lent_ = ring.buffer(bid);
+#endif
+}
+
+void ReadBuffer::reset() {
+#ifndef _WIN32
+    if (ring_) ring_->recycle_buffer(bid_);
+#endif
+    ring_ = nullptr;
+    lent_ = nullptr;
+}
+
 Socket::Socket(NativeSocket fd) : fd_(fd) {
     if (fd_ == INVALID_SOCKET_VAL) {
+#ifdef _WIN32
         fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+#else
+        // CLOEXEC everywhere: spawned Python workers must not inherit our fds
+        fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+#endif
         if (fd_ == INVALID_SOCKET_VAL) {
             throw std::runtime_error("Failed to create socket");
         }
@@ -53,11 +89,21 @@ Socket& Socket::operator=(Socket&& other) noexcept {
 
 void Socket::close() {
     if (fd_ != INVALID_SOCKET_VAL) {
+        EventLoop::instance().unregister_handle(fd_);
         closesocket(fd_);
         fd_ = INVALID_SOCKET_VAL;
     }
 }
 
+void Socket::shutdown() {
+    if (fd_ == INVALID_SOCKET_VAL) return;
+#ifdef _WIN32
+    ::shutdown(fd_, SD_BOTH);
+#else
+    ::shutdown(fd_, SHUT_RDWR);
+#endif
+}
+
 void Socket::set_non_blocking() {
 #ifdef _WIN32
     u_long mode = 1;
@@ -68,6 +114,26 @@ void Socket::set_non_blocking() {
 #endif
 }
 
+void Socket::set_no_delay() {
+    // Responses are already batched into one write; Nagle would only hold
+    // back the tail of a pipelined batch waiting for the client's ACK
+    int opt = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, (char*)&opt, sizeof(opt));
+}
+
+void Socket::set_reuse_port() {
+#ifdef SO_REUSEPORT
+    // Lets several sockets bind the same ip:port; the kernel spreads
+    // incoming connections across them.
+    int opt = 1;
+    if (setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, (char*)&opt, sizeof(opt)) < 0) {
+        throw std::runtime_error("Failed to set SO_REUSEPORT");
+    }
+#else
+    throw std::runtime_error("SO_REUSEPORT is not supported on this platform");
+#endif
+}
+
 void Socket::bind(const char* ip, int port) {
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
@@ -83,6 +149,40 @@ void Socket::bind(const char* ip, int port) {
     }
 }
 
+#ifndef _WIN32
+Socket Socket::unix_stream() {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create unix socket");
+    }
+    return Socket(fd);
+}
+
+void Socket::bind_unix(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Invalid unix socket path");
+    }
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    if (path[0] == '@') addr.sun_path[0] = '\0'; // Abstract namespace
+
+    socklen_t len = offsetof(sockaddr_un, sun_path) + path.size();
+    if (::bind(fd_, (struct sockaddr*)&addr, len) < 0) {
+        throw std::runtime_error(fmt::format("Failed to bind unix socket {}", path));
+    }
+}
+#endif
+
+int Socket::local_port() const {
+    sockaddr_in addr{};
+    socklen_t len = sizeof(addr);
+    if (getsockname(fd_, (struct sockaddr*)&addr, &len) < 0) {
+        throw std::runtime_error("Failed to get socket name");
+    }
+    return ntohs(addr.sin_port);
+}
+
 void Socket::listen() {
     if (::listen(fd_, SOMAXCONN) < 0) {
         throw std::runtime_error("Failed to listen on socket");
@@ -92,7 +192,11 @@ void Socket::listen() {
 std::optional<Socket> Socket::accept() {
     sockaddr_in client_addr{};
     socklen_t len = sizeof(client_addr);
+#ifdef _WIN32
     NativeSocket client_fd = ::accept(fd_, (struct sockaddr*)&client_addr, &len);
+#else
+    NativeSocket client_fd = ::accept4(fd_, (struct sockaddr*)&client_addr, &len, SOCK_CLOEXEC);
+#endif
     
     if (client_fd == INVALID_SOCKET_VAL) {
         if (is_would_block()) return std::nullopt;
@@ -204,71 +308,357 @@ Task<Socket> Socket::accept_async() {
 }
 
 
-Task<size_t> Socket::read(std::span<char> buffer) {
-    co_return co_await IocpAwaitable{
+Socket::ReadOp Socket::read_lent(ReadBuffer& into) {
+    return read(into.own());
+}
+
+Socket::ReadOp Socket::read(std::span<char> buffer) {
+    return IocpAwaitable{
         EventLoop::instance(), fd_, 
         buffer.data(), (DWORD)buffer.size(), 
-        false // read
+        false, // read
+        {}
     };
 }
 
-Task<size_t> Socket::write(std::span<const char> buffer) {
-    co_return co_await IocpAwaitable{
+Socket::WriteOp Socket::write(std::span<const char> buffer) {
+    return IocpAwaitable{
         EventLoop::instance(), fd_, 
         (void*)buffer.data(), (DWORD)buffer.size(), 
-        true // write
+        true, // write
+        {}
     };
 }
 
+Task<size_t> Socket::write_vectored(std::span<IoSlice> slices, bool) {
+    // One overlapped send per slice
+    size_t total = 0;
+    for (const WSABUF& s : slices) {
+        size_t n = co_await write(std::span<const char>(s.buf, s.len));
+        total += n;
+        if (n != s.len) break;
+    }
+    co_return total;
+}
+
 #else
 
 // Linux Implementation
 
+// ---- ReadOp ----
+
+bool Socket::ReadOp::attempt() {
+    result = ::read(fd, buffer.data(), buffer.size());
+    if (result < 0 && is_would_block()) return false;
+    return true; // Data, EOF or a hard error
+}
+
+bool Socket::ReadOp::await_ready() {
+    if (loop.backend() == IoBackend::IoUring) return false;
+    return attempt();
+}
+
+void Socket::ReadOp::await_suspend(std::coroutine_handle<> h) {
+    if (loop.backend() == IoBackend::IoUring) {
+        uop.handle = h;
+        uop.try_complete = &uring_complete;
+        uop.context = this;
+        submit_uring(buffer.empty());
+        return;
+    }
+    handle = h;
+    try_complete = &retry;
+    loop.add_reader(fd, this);
+}
+
+bool Socket::ReadOp::retry(IoWaiter* w) {
+    return static_cast<ReadOp*>(w)->attempt();
+}
+
+// Reads with a provided buffer let the kernel pick one only once data
+// arrives; it is then lent to the caller's ReadBuffer.
+void Socket::ReadOp::submit_uring(bool select_buffer) {
+    Uring& ring = loop.uring();
+    io_uring_sqe* sqe = ring.get_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    if (select_buffer) {
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = ring.buffer_group();
+        sqe->len = ring.buffer_size();
+    } else {
+        sqe->addr = reinterpret_cast<uint64_t>(buffer.data());
+        sqe->len = (unsigned)buffer.size();
+    }
+    sqe->user_data = reinterpret_cast<uint64_t>(&uop);
+}
+
+bool Socket::ReadOp::uring_complete(UringOperation* op) {
+    auto* self = static_cast<ReadOp*>(op->context);
+    if (op->result == -ENOBUFS) {
+        // Provided buffers exhausted (all lent out), read into our own
+        self->buffer = self->lend->own();
+        self->submit_uring(false);
+        return false;
+    }
+    if (op->flags & IORING_CQE_F_BUFFER) {
+        self->lend->lend(self->loop.uring(), (uint16_t)(op->flags >> IORING_CQE_BUFFER_SHIFT));
+    }
+    self->result = op->result;
+    return true;
+}
+
+// ---- WriteOp ----
+
+bool Socket::WriteOp::attempt() {
+    while (written < buffer.size()) {
+        ssize_t n = ::send(fd, buffer.data() + written, buffer.size() - written, MSG_NOSIGNAL);
+        if (n >= 0) {
+            written += n;
+        } else if (is_would_block()) {
+            return false;
+        } else {
+            failed = true; // Partial or error
+            return true;
+        }
+    }
+    return true;
+}
+
+bool Socket::WriteOp::await_ready() {
+    if (loop.backend() == IoBackend::IoUring) return buffer.empty();
+    return attempt();
+}
+
+void Socket::WriteOp::await_suspend(std::coroutine_handle<> h) {
+    if (loop.backend() == IoBackend::IoUring) {
+        uop.handle = h;
+        uop.try_complete = &uring_complete;
+        uop.context = this;
+        submit_uring();
+        return;
+    }
+    handle = h;
+    try_complete = &retry;
+    loop.add_writer(fd, this);
+}
+
+bool Socket::WriteOp::retry(IoWaiter* w) {
+    return static_cast<WriteOp*>(w)->attempt();
+}
+
+void Socket::WriteOp::submit_uring() {
+    io_uring_sqe* sqe = loop.uring().get_sqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer.data() + written);
+    sqe->len = (unsigned)(buffer.size() - written);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = reinterpret_cast<uint64_t>(&uop);
+}
+
+bool Socket::WriteOp::uring_complete(UringOperation* op) {
+    auto* self = static_cast<WriteOp*>(op->context);
+    if (op->result <= 0) {
+        self->failed = true;
+        return true;
+    }
+    self->written += op->result;
+    if (self->written < self->buffer.size()) {
+        self->submit_uring(); // Short send, queue the rest
+        return false;
+    }
+    return true;
+}
+
+// ---- WritevOp ----
+
+void Socket::WritevOp::consume(size_t n) {
+    written += n;
+    while (!slices.empty() && n >= slices.front().iov_len) {
+        n -= slices.front().iov_len;
+        slices = slices.subspan(1);
+    }
+    if (n > 0) {
+        slices.front().iov_base = static_cast<char*>(slices.front().iov_base) + n;
+        slices.front().iov_len -= n;
+    }
+}
+
+void Socket::WritevOp::prepare() {
+    // Empty slices would make a zero-length send look like completion
+    while (!slices.empty() && slices.front().iov_len == 0) slices = slices.subspan(1);
+    msg.msg_iov = slices.data();
+    msg.msg_iovlen = std::min<size_t>(slices.size(), IOV_MAX);
+}
+
+bool Socket::WritevOp::attempt() {
+    for (prepare(); !slices.empty(); prepare()) {
+        ssize_t n = ::sendmsg(fd, &msg, flags);
+        if (n >= 0) {
+            consume((size_t)n);
+        } else if (is_would_block()) {
+            return false;
+        } else {
+            failed = true;
+            return true;
+        }
+    }
+    return true;
+}
+
+bool Socket::WritevOp::await_ready() {
+    if (loop.backend() == IoBackend::IoUring) {
+        prepare();
+        return slices.empty();
+    }
+    return attempt();
+}
+
+void Socket::WritevOp::await_suspend(std::coroutine_handle<> h) {
+    if (loop.backend() == IoBackend::IoUring) {
+        uop.handle = h;
+        uop.try_complete = &uring_complete;
+        uop.context = this;
+        submit_uring();
+        return;
+    }
+    handle = h;
+    try_complete = &retry;
+    loop.add_writer(fd, this);
+}
+
+bool Socket::WritevOp::retry(IoWaiter* w) {
+    return static_cast<WritevOp*>(w)->attempt();
+}
+
+void Socket::WritevOp::submit_uring() {
+    prepare();
+    io_uring_sqe* sqe = loop.uring().get_sqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&msg);
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+    sqe->user_data = reinterpret_cast<uint64_t>(&uop);
+}
+
+bool Socket::WritevOp::uring_complete(UringOperation* op) {
+    auto* self = static_cast<WritevOp*>(op->context);
+    if (op->result <= 0) {
+        self->failed = true;
+        return true;
+    }
+    self->consume((size_t)op->result);
+    self->prepare();
+    if (!self->slices.empty()) {
+        self->submit_uring(); // Short send, queue the rest
+        return false;
+    }
+    return true;
+}
+
+// ---- SendFileOp ----
+
+bool Socket::SendFileOp::attempt() {
+    while (remaining > 0) {
+        ssize_t n = ::sendfile(fd, file_fd, &offset, remaining);
+        if (n > 0) {
+            sent += n;
+            remaining -= n;
+        } else if (n < 0 && is_would_block()) {
+            return false;
+        } else {
+            return true; // Error, or the file shrank under us
+        }
+    }
+    return true;
+}
+
+void Socket::SendFileOp::await_suspend(std::coroutine_handle<> h) {
+    if (loop.backend() == IoBackend::IoUring) {
+        uop.handle = h;
+        uop.try_complete = &uring_complete;
+        uop.context = this;
+        submit_poll();
+        return;
+    }
+    handle = h;
+    try_complete = &retry;
+    loop.add_writer(fd, this);
+}
+
+bool Socket::SendFileOp::retry(IoWaiter* w) {
+    return static_cast<SendFileOp*>(w)->attempt();
+}
+
+void Socket::SendFileOp::submit_poll() {
+    io_uring_sqe* sqe = loop.uring().get_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLOUT;
+    sqe->user_data = reinterpret_cast<uint64_t>(&uop);
+}
+
+bool Socket::SendFileOp::uring_complete(UringOperation* op) {
+    auto* self = static_cast<SendFileOp*>(op->context);
+    if (op->result < 0 || self->attempt()) return true;
+    self->submit_poll();
+    return false;
+}
+
 Task<Socket> Socket::accept_async() {
+    EventLoop& loop = EventLoop::instance();
+    if (loop.backend() == IoBackend::IoUring) {
+        UringAcceptor& acc = loop.acceptor(fd_);
+        while (acc.ready.empty()) {
+            if (!acc.armed) loop.arm_accept(fd_, acc);
+            co_await AcceptWaitAwaitable{acc};
+        }
+        int client_fd = acc.ready.front();
+        acc.ready.pop_front();
+        co_return Socket(client_fd >= 0 ? client_fd : INVALID_SOCKET_VAL);
+    }
+
     while (true) {
         sockaddr_in client_addr{};
         socklen_t len = sizeof(client_addr);
-        NativeSocket client_fd = ::accept(fd_, (struct sockaddr*)&client_addr, &len);
+        NativeSocket client_fd = ::accept4(fd_, (struct sockaddr*)&client_addr, &len, SOCK_CLOEXEC);
 
         if (client_fd != INVALID_SOCKET_VAL) {
+            loop.register_handle(client_fd);
             co_return Socket(client_fd);
         }
 
         if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            co_await ReadAwaitable{fd_};
+            co_await ReadableAwaitable{fd_};
         } else {
             co_return Socket(INVALID_SOCKET_VAL);
         }
     }
 }
 
-Task<size_t> Socket::read(std::span<char> buffer) {
-    while (true) {
-        ssize_t n = ::read(fd_, buffer.data(), buffer.size());
-        if (n >= 0) co_return n;
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            co_await ReadAwaitable{fd_};
-        } else {
-            // Error
-            co_return 0; 
-        }
-    }
+Socket::ReadOp Socket::read(std::span<char> buffer) {
+    return ReadOp(EventLoop::instance(), fd_, buffer);
 }
 
-Task<size_t> Socket::write(std::span<const char> buffer) {
-    size_t total = 0;
-    while (total < buffer.size()) {
-        ssize_t n = ::write(fd_, buffer.data() + total, buffer.size() - total);
-        if (n >= 0) {
-            total += n;
-            if (total == buffer.size()) co_return total;
-        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            co_await WriteAwaitable{fd_};
-        } else {
-            co_return total; // Partial or error
-        }
-    }
-    co_return total;
+Socket::ReadOp Socket::read_lent(ReadBuffer& into) {
+    into.reset();
+    EventLoop& loop = EventLoop::instance();
+    bool provided = loop.backend() == IoBackend::IoUring && loop.uring().has_buffer_ring();
+    return ReadOp(loop, fd_, provided ? std::span<char>{} : into.own(), &into);
+}
+
+Socket::WriteOp Socket::write(std::span<const char> buffer) {
+    return WriteOp(EventLoop::instance(), fd_, buffer);
+}
+
+Socket::WritevOp Socket::write_vectored(std::span<IoSlice> slices, bool more) {
+    return WritevOp(EventLoop::instance(), fd_, slices, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+}
+
+Socket::SendFileOp Socket::send_file(int file_fd, uint64_t offset, size_t count) {
+    return SendFileOp(EventLoop::instance(), fd_, file_fd, offset, count);
 }
 
 #endif
@@ -6,9 +6,43 @@
 #include <vector>
 #include <span>
 #include <optional>
+#include <string>
+#include <string_view>
 
 namespace cppcorn::core {
 
+class Uring;
+
+// Where Socket::read_lent() leaves what it read. On io_uring with a
+// provided-buffer ring, the kernel picks a buffer only once data arrives and
+// it is lent out as is: nothing is copied, and nothing is held between
+// reads. Otherwise (epoll, or the ring ran dry) the data lands in a buffer
+// of our own, allocated on first use.
+class ReadBuffer {
+public:
+    static constexpr size_t OWN_BYTES = 8192;
+
+    ReadBuffer() = default;
+    ~ReadBuffer() { reset(); }
+    ReadBuffer(const ReadBuffer&) = delete;
+    ReadBuffer& operator=(const ReadBuffer&) = delete;
+
+    // The `n` bytes the last read returned
+    std::string_view view(size_t n) const { return {lent_ ? lent_ : own_.data(), n}; }
+    // Hands a lent buffer back to the ring; view() is invalid afterwards
+    void reset();
+
+    // For Socket
+    std::span<char> own();
+    void lend(Uring& ring, uint16_t bid);
+
+private:
+    const char* lent_ = nullptr;
+    Uring* ring_ = nullptr;
+    uint16_t bid_ = 0;
+    std::vector<char> own_;
+};
+
 class Socket {
 public:
     explicit Socket(NativeSocket fd = INVALID_SOCKET_VAL);
@@ -22,20 +56,24 @@ public:
 
     NativeSocket fd() const { return fd_; }
     void close();
+    // Shuts down both directions; pending reads/writes complete with 0.
+    // Used to abort I/O from a timer without closing the fd under it.
+    void shutdown();
 
     // Setup
     void bind(const char* ip, int port);
     void listen();
     std::optional<Socket> accept(); // Sync accept for now
     void set_non_blocking();
+    void set_no_delay(); // TCP_NODELAY
+    void set_reuse_port(); // Must be called before bind()
+    int local_port() const; // e.g. after binding port 0
 
-    // Async Operations
-    Task<size_t> read(std::span<char> buffer);
-    Task<size_t> write(std::span<const char> buffer);
-    Task<Socket> accept_async();
-
-private:
-    NativeSocket fd_;
+#ifndef _WIN32
+    static Socket unix_stream(); // AF_UNIX, SOCK_STREAM
+    // A leading '@' binds in the abstract namespace (no file to clean up)
+    void bind_unix(const std::string& path);
+#endif
 
 #ifdef _WIN32
     // Windows Awaitable
@@ -52,6 +90,146 @@ private:
         size_t await_resume();
     };
 
+    using ReadOp = IocpAwaitable;
+    using WriteOp = IocpAwaitable;
+    using IoSlice = WSABUF;
+#else
+    using IoSlice = iovec;
+
+    // Returned by read(). The syscall is attempted in await_ready, so data
+    // that is already there completes without suspending or allocating; only
+    // EAGAIN parks the coroutine (and the loop retries before resuming it).
+    // On io_uring a recv SQE is submitted instead.
+    struct ReadOp : IoWaiter {
+        EventLoop& loop;
+        int fd;
+        std::span<char> buffer; // Empty while the kernel is to pick one
+        ReadBuffer* lend;       // Set by read_lent()
+        ssize_t result = 0;
+        UringOperation uop;
+
+        ReadOp(EventLoop& l, int f, std::span<char> b, ReadBuffer* r = nullptr)
+            : loop(l), fd(f), buffer(b), lend(r) {}
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> h);
+        size_t await_resume() const { return result > 0 ? (size_t)result : 0; }
+
+    private:
+        bool attempt();
+        void submit_uring(bool select_buffer);
+        static bool retry(IoWaiter* w);
+        static bool uring_complete(UringOperation* op);
+    };
+
+    // Returned by write(). Writes the whole buffer, suspending only while the
+    // socket is full. Resumes with the bytes written (short on error).
+    struct WriteOp : IoWaiter {
+        EventLoop& loop;
+        int fd;
+        std::span<const char> buffer;
+        size_t written = 0;
+        bool failed = false;
+        UringOperation uop;
+
+        WriteOp(EventLoop& l, int f, std::span<const char> b) : loop(l), fd(f), buffer(b) {}
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> h);
+        size_t await_resume() const { return written; }
+
+    private:
+        bool attempt();
+        void submit_uring();
+        static bool retry(IoWaiter* w);
+        static bool uring_complete(UringOperation* op);
+    };
+
+    // Returned by write_vectored(). Like WriteOp, but gathers the slices into
+    // as few sendmsg calls as the socket allows. The slices are advanced in
+    // place as bytes go out, so they must outlive the operation.
+    struct WritevOp : IoWaiter {
+        EventLoop& loop;
+        int fd;
+        std::span<iovec> slices;
+        int flags;
+        size_t written = 0;
+        bool failed = false;
+        msghdr msg{};
+        UringOperation uop;
+
+        WritevOp(EventLoop& l, int f, std::span<iovec> s, int fl)
+            : loop(l), fd(f), slices(s), flags(fl) {}
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> h);
+        size_t await_resume() const { return written; }
+
+    private:
+        bool attempt();
+        void consume(size_t n);
+        void prepare();
+        void submit_uring();
+        static bool retry(IoWaiter* w);
+        static bool uring_complete(UringOperation* op);
+    };
+
+    // Returned by send_file(). Copies file bytes to the socket in the kernel
+    // (sendfile), suspending while the socket is full; on io_uring the wait
+    // is a POLL_ADD for writability. Resumes with the bytes sent.
+    struct SendFileOp : IoWaiter {
+        EventLoop& loop;
+        int fd;
+        int file_fd;
+        off_t offset;
+        size_t remaining;
+        size_t sent = 0;
+        UringOperation uop;
+
+        SendFileOp(EventLoop& l, int f, int file, uint64_t off, size_t count)
+            : loop(l), fd(f), file_fd(file), offset((off_t)off), remaining(count) {}
+
+        bool await_ready() { return attempt(); }
+        void await_suspend(std::coroutine_handle<> h);
+        size_t await_resume() const { return sent; }
+
+    private:
+        bool attempt();
+        void submit_poll();
+        static bool retry(IoWaiter* w);
+        static bool uring_complete(UringOperation* op);
+    };
+#endif
+
+    // Async Operations
+    ReadOp read(std::span<char> buffer);
+    // Reads into `into` (see ReadBuffer), first resetting it; resumes with
+    // the bytes read
+    ReadOp read_lent(ReadBuffer& into);
+    WriteOp write(std::span<const char> buffer);
+    static IoSlice slice(std::string_view data) {
+#ifdef _WIN32
+        return {(ULONG)data.size(), const_cast<char*>(data.data())};
+#else
+        return {const_cast<char*>(data.data()), data.size()};
+#endif
+    }
+#ifdef _WIN32
+    Task<size_t> write_vectored(std::span<IoSlice> slices, bool more = false);
+#else
+    // Writes every slice in order; resumes with the total bytes written
+    // (short on error). `more` tells the kernel more data follows at once
+    // (MSG_MORE), so a header block can share a packet with a send_file().
+    WritevOp write_vectored(std::span<IoSlice> slices, bool more = false);
+    // Sends `count` bytes of `file_fd` from `offset`
+    SendFileOp send_file(int file_fd, uint64_t offset, size_t count);
+#endif
+    Task<Socket> accept_async();
+
+private:
+    NativeSocket fd_;
+
+#ifdef _WIN32
     struct AcceptAwaitable {
         EventLoop& loop;
         NativeSocket listen_fd;
@@ -65,21 +243,21 @@ private:
     };
 #else
     // Linux Awaitables
-    struct ReadAwaitable {
+    struct ReadableAwaitable : IoWaiter {
         int fd;
+        explicit ReadableAwaitable(int f) : fd(f) {}
         constexpr bool await_ready() const noexcept { return false; }
         void await_suspend(std::coroutine_handle<> h) {
-            EventLoop::instance().add_reader(fd, h);
+            handle = h;
+            EventLoop::instance().add_reader(fd, this);
         }
         void await_resume() {}
     };
 
-    struct WriteAwaitable {
-        int fd;
-        constexpr bool await_ready() const noexcept { return false; }
-        void await_suspend(std::coroutine_handle<> h) {
-            EventLoop::instance().add_writer(fd, h);
-        }
+    struct AcceptWaitAwaitable {
+        UringAcceptor& acceptor;
+        bool await_ready() const noexcept { return !acceptor.ready.empty(); }
+        void await_suspend(std::coroutine_handle<> h) { acceptor.waiter = h; }
         void await_resume() {}
     };
 #endif
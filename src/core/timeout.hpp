@@ -0,0 +1,78 @@
+#pragma once
+
+#include "event_loop.hpp"
+#include "coroutine.hpp"
+#include "timer.hpp"
+#include <chrono>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace cppcorn::core {
+
+// co_await sleep_for(100ms) suspends on the current thread's loop.
+struct SleepAwaitable : TimerNode {
+    std::chrono::milliseconds delay;
+    std::coroutine_handle<> handle;
+
+    explicit SleepAwaitable(std::chrono::milliseconds d) : delay(d) {}
+
+    bool await_ready() const noexcept { return delay.count() <= 0; }
+    void await_suspend(std::coroutine_handle<> h) {
+        handle = h;
+        on_expire = [](TimerNode* n) {
+            static_cast<SleepAwaitable*>(n)->handle.resume();
+        };
+        EventLoop::instance().timers().schedule(*this, delay.count());
+    }
+    void await_resume() noexcept {}
+};
+
+inline SleepAwaitable sleep_for(std::chrono::milliseconds delay) {
+    return SleepAwaitable(delay);
+}
+
+// Awaits `op`, calling `cancel()` if it hasn't finished within `timeout`.
+// `cancel` must make the pending operation complete promptly (for sockets:
+// Socket::shutdown). Returns std::nullopt if the timeout fired, otherwise the
+// operation's result (true for void operations).
+template <typename Awaitable, typename Cancel>
+auto with_timeout(Awaitable op, std::chrono::milliseconds timeout, Cancel cancel)
+    -> Task<std::optional<std::conditional_t<
+           std::is_void_v<decltype(std::declval<Awaitable&>().await_resume())>, bool,
+           std::decay_t<decltype(std::declval<Awaitable&>().await_resume())>>>> {
+    struct Deadline : TimerNode {
+        Cancel cancel;
+        bool fired = false;
+    };
+
+    Deadline deadline{{}, std::move(cancel)};
+    deadline.on_expire = [](TimerNode* n) {
+        auto* d = static_cast<Deadline*>(n);
+        d->fired = true;
+        d->cancel();
+    };
+
+    TimerWheel& timers = EventLoop::instance().timers();
+    timers.schedule(deadline, timeout.count());
+
+    using Result = decltype(std::declval<Awaitable&>().await_resume());
+    try {
+        if constexpr (std::is_void_v<Result>) {
+            co_await std::move(op);
+            timers.cancel(deadline);
+            if (deadline.fired) co_return std::nullopt;
+            co_return true;
+        } else {
+            auto result = co_await std::move(op);
+            timers.cancel(deadline);
+            if (deadline.fired) co_return std::nullopt;
+            co_return std::move(result);
+        }
+    } catch (...) {
+        timers.cancel(deadline);
+        throw;
+    }
+}
+
+} // namespace cppcorn::core
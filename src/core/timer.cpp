@@ -0,0 +1,122 @@
+#include "timer.hpp"
+#include <algorithm>
+
+namespace cppcorn::core {
+
+TimerWheel::TimerWheel(uint64_t now_ms) : now_(now_ms) {
+    for (auto& level : slots_) {
+        for (auto& slot : level) {
+            slot.prev = slot.next = &slot;
+        }
+    }
+}
+
+void TimerWheel::push(TimerNode& slot, TimerNode& node) {
+    node.prev = slot.prev;
+    node.next = &slot;
+    slot.prev->next = &node;
+    slot.prev = &node;
+}
+
+void TimerWheel::unlink(TimerNode& node) {
+    node.prev->next = node.next;
+    node.next->prev = node.prev;
+    node.prev = node.next = nullptr;
+}
+
+void TimerWheel::schedule(TimerNode& node, uint64_t delay_ms) {
+    if (node.scheduled()) {
+        cancel(node);
+    }
+    // The current tick's slot has already fired, so the earliest is the next one
+    node.expires = now_ + std::max<uint64_t>(delay_ms, 1);
+    ++count_;
+    insert(node);
+}
+
+void TimerWheel::cancel(TimerNode& node) {
+    if (!node.scheduled()) return;
+    unlink(node);
+    --count_;
+}
+
+void TimerWheel::insert(TimerNode& node) {
+    uint64_t when = std::max(node.expires, now_);
+    uint64_t delta = when - now_;
+
+    for (int level = 0; level < LEVELS; ++level) {
+        int shift = SLOT_BITS * (level + 1);
+        if (delta < (uint64_t(1) << shift)) {
+            push(slots_[level][(when >> (SLOT_BITS * level)) & (SLOTS - 1)], node);
+            return;
+        }
+    }
+
+    // Beyond the wheel's range: park in the outermost level, re-cascaded later
+    int top = LEVELS - 1;
+    when = now_ + (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+    push(slots_[top][(when >> (SLOT_BITS * top)) & (SLOTS - 1)], node);
+}
+
+void TimerWheel::cascade(int level) {
+    TimerNode& slot = slots_[level][(now_ >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    while (slot.next != &slot) {
+        TimerNode& node = *slot.next;
+        unlink(node);
+        insert(node);
+    }
+}
+
+void TimerWheel::advance(uint64_t now_ms) {
+    while (now_ < now_ms) {
+        if (count_ == 0) {
+            now_ = now_ms;
+            return;
+        }
+
+        ++now_;
+        for (int level = 1; level < LEVELS; ++level) {
+            if (now_ & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) break;
+            cascade(level);
+        }
+
+        // Detach the due slot first: callbacks may schedule or cancel timers
+        TimerNode& slot = slots_[0][now_ & (SLOTS - 1)];
+        if (slot.next == &slot) continue;
+
+        TimerNode due;
+        due.prev = slot.prev;
+        due.next = slot.next;
+        due.prev->next = &due;
+        due.next->prev = &due;
+        slot.prev = slot.next = &slot;
+
+        while (due.next != &due) {
+            TimerNode& node = *due.next;
+            unlink(node);
+            --count_;
+            node.on_expire(&node);
+        }
+    }
+}
+
+int64_t TimerWheel::next_timeout() const {
+    if (count_ == 0) return -1;
+
+    uint64_t best = UINT64_MAX;
+    for (int level = 0; level < LEVELS; ++level) {
+        int shift = SLOT_BITS * level;
+        uint64_t cur = now_ >> shift;
+        for (uint64_t k = 1; k <= SLOTS; ++k) {
+            const TimerNode& slot = slots_[level][(cur + k) & (SLOTS - 1)];
+            if (slot.next != &slot) {
+                // Level 0 slots fire at that tick, higher ones cascade then
+                best = std::min(best, ((cur + k) << shift) - now_);
+                break;
+            }
+        }
+    }
+    return (int64_t)best;
+}
+
+} // namespace cppcorn::core
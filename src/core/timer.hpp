@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace cppcorn::core {
+
+// Intrusive timer entry. Owners embed (or derive from) it and set on_expire;
+// the wheel never allocates.
+struct TimerNode {
+    uint64_t expires = 0; // Absolute, in wheel ticks (ms)
+    void (*on_expire)(TimerNode*) = nullptr;
+
+    TimerNode* prev = nullptr;
+    TimerNode* next = nullptr;
+
+    bool scheduled() const { return next != nullptr; }
+};
+
+// Hierarchical timer wheel: 4 levels of 64 slots at 1 ms resolution, which
+// covers ~4.6 hours before timers are clamped to the outermost slot and
+// re-cascaded. Schedule/cancel are O(1); advancing is amortised O(1) per tick.
+class TimerWheel {
+public:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+
+    explicit TimerWheel(uint64_t now_ms = 0);
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    uint64_t now() const { return now_; }
+    bool empty() const { return count_ == 0; }
+
+    // Fires `node` `delay_ms` after the wheel's current time. Re-scheduling
+    // an already scheduled node moves it.
+    void schedule(TimerNode& node, uint64_t delay_ms);
+    void cancel(TimerNode& node);
+
+    // Moves the wheel to `now_ms`, running on_expire for every due timer.
+    void advance(uint64_t now_ms);
+
+    // Milliseconds until the wheel next needs advancing (a timer expires or a
+    // higher level cascades), or -1 if no timers are scheduled.
+    int64_t next_timeout() const;
+
+private:
+    void insert(TimerNode& node);
+    void cascade(int level);
+
+    static void unlink(TimerNode& node);
+    static void push(TimerNode& slot, TimerNode& node);
+
+    // Each slot is the sentinel of a circular list
+    TimerNode slots_[LEVELS][SLOTS];
+    uint64_t now_;
+    size_t count_ = 0;
+};
+
+} // namespace cppcorn::core
@@ -0,0 +1,234 @@
+#include "uring.hpp"
+
+#ifndef _WIN32
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <fmt/core.h>
+
+namespace cppcorn::core {
+
+static int sys_io_uring_setup(unsigned entries, io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+template <typename T>
+static T* ring_ptr(void* base, unsigned offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+static unsigned load_acquire(unsigned* p) {
+    return std::atomic_ref<unsigned>(*p).load(std::memory_order_acquire);
+}
+
+static void store_release(unsigned* p, unsigned v) {
+    std::atomic_ref<unsigned>(*p).store(v, std::memory_order_release);
+}
+
+Uring::Uring(unsigned entries) {
+    io_uring_params params{};
+    // Only the owning loop thread ever submits
+    params.flags = IORING_SETUP_SINGLE_ISSUER;
+    ring_fd_ = sys_io_uring_setup(entries, &params);
+    if (ring_fd_ < 0 && errno == EINVAL) {
+        params = io_uring_params{};
+        ring_fd_ = sys_io_uring_setup(entries, &params);
+    }
+    if (ring_fd_ < 0) {
+        throw std::runtime_error(fmt::format("io_uring_setup failed: {}", strerror(errno)));
+    }
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+
+    sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED) {
+        close(ring_fd_);
+        throw std::runtime_error("Failed to map io_uring SQ ring");
+    }
+    if (single_mmap) {
+        cq_ptr_ = sq_ptr_;
+    } else {
+        cq_ptr_ = mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ptr_ == MAP_FAILED) {
+            munmap(sq_ptr_, sq_size_);
+            close(ring_fd_);
+            throw std::runtime_error("Failed to map io_uring CQ ring");
+        }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        if (cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_size_);
+        munmap(sq_ptr_, sq_size_);
+        close(ring_fd_);
+        throw std::runtime_error("Failed to map io_uring SQEs");
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    sq_head_ = ring_ptr<unsigned>(sq_ptr_, params.sq_off.head);
+    sq_tail_ = ring_ptr<unsigned>(sq_ptr_, params.sq_off.tail);
+    sq_mask_ = *ring_ptr<unsigned>(sq_ptr_, params.sq_off.ring_mask);
+    sq_entries_ = *ring_ptr<unsigned>(sq_ptr_, params.sq_off.ring_entries);
+    sq_array_ = ring_ptr<unsigned>(sq_ptr_, params.sq_off.array);
+    sqe_tail_ = *sq_tail_;
+
+    cq_head_ = ring_ptr<unsigned>(cq_ptr_, params.cq_off.head);
+    cq_tail_ = ring_ptr<unsigned>(cq_ptr_, params.cq_off.tail);
+    cq_mask_ = *ring_ptr<unsigned>(cq_ptr_, params.cq_off.ring_mask);
+    cqes_ = ring_ptr<io_uring_cqe>(cq_ptr_, params.cq_off.cqes);
+}
+
+Uring::~Uring() {
+    if (buf_ring_) {
+        io_uring_buf_reg reg{};
+        reg.bgid = buf_group_;
+        sys_io_uring_register(ring_fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        munmap(buf_ring_, buf_ring_size_);
+        delete[] buf_base_;
+    }
+    munmap(sqes_, sqes_size_);
+    if (cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_size_);
+    munmap(sq_ptr_, sq_size_);
+    close(ring_fd_);
+}
+
+bool Uring::sq_full() const {
+    return sqe_tail_ - load_acquire(sq_head_) >= sq_entries_;
+}
+
+io_uring_sqe* Uring::get_sqe() {
+    while (sq_full()) {
+        // Ring full: hand what we have to the kernel first. It may take only
+        // part of it, or refuse while the CQ ring is backed up (EBUSY), so
+        // make room there and go again; the slot isn't ours until it's taken.
+        unsigned before = to_submit_;
+        enter(to_submit_, 0);
+        if (!sq_full()) break;
+        if (stash_completions() == 0 && to_submit_ == before) {
+            throw std::runtime_error("io_uring submission queue is stuck");
+        }
+    }
+    unsigned idx = sqe_tail_ & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[idx] = idx;
+    ++sqe_tail_;
+    ++to_submit_;
+    return sqe;
+}
+
+void Uring::enter(unsigned to_submit, unsigned wait_nr) {
+    store_release(sq_tail_, sqe_tail_);
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    while (true) {
+        int ret = sys_io_uring_enter(ring_fd_, to_submit, wait_nr, flags);
+        if (ret >= 0) {
+            to_submit_ -= std::min<unsigned>(to_submit_, (unsigned)ret);
+            return;
+        }
+        if (errno == EINTR) continue;
+        // EBUSY/EAGAIN: CQ is backed up; the caller drains it and retries
+        if (errno == EBUSY || errno == EAGAIN) return;
+        throw std::runtime_error(fmt::format("io_uring_enter failed: {}", strerror(errno)));
+    }
+}
+
+void Uring::submit_and_wait(unsigned wait_nr) {
+    if (backlog_pos_ < backlog_.size() || load_acquire(cq_tail_) != *cq_head_) {
+        // Completions already pending, don't block
+        wait_nr = 0;
+    }
+    if (to_submit_ == 0 && wait_nr == 0) return;
+    enter(to_submit_, wait_nr);
+}
+
+bool Uring::next_cqe(io_uring_cqe& out) {
+    if (backlog_pos_ < backlog_.size()) {
+        out = backlog_[backlog_pos_++];
+        if (backlog_pos_ == backlog_.size()) {
+            backlog_.clear();
+            backlog_pos_ = 0;
+        }
+        return true;
+    }
+    unsigned head = *cq_head_;
+    if (head == load_acquire(cq_tail_)) return false;
+    out = cqes_[head & cq_mask_];
+    store_release(cq_head_, head + 1);
+    return true;
+}
+
+size_t Uring::stash_completions() {
+    size_t n = 0;
+    unsigned head = *cq_head_;
+    unsigned tail = load_acquire(cq_tail_);
+    for (; head != tail; ++head, ++n) {
+        backlog_.push_back(cqes_[head & cq_mask_]);
+    }
+    store_release(cq_head_, head);
+    return n;
+}
+
+bool Uring::setup_buffer_ring(uint16_t group, unsigned count, unsigned size) {
+    buf_ring_size_ = count * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring == MAP_FAILED) return false;
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (sys_io_uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        // Kernel < 5.19: reads fall back to caller-owned buffers
+        munmap(ring, buf_ring_size_);
+        return false;
+    }
+
+    buf_ring_ = static_cast<io_uring_buf*>(ring);
+    buf_count_ = count;
+    buf_size_ = size;
+    buf_group_ = group;
+    buf_base_ = new char[(size_t)count * size];
+    for (unsigned i = 0; i < count; ++i) {
+        recycle_buffer((uint16_t)i);
+    }
+    return true;
+}
+
+void Uring::recycle_buffer(uint16_t bid) {
+    io_uring_buf& b = buf_ring_[buf_tail_ & (buf_count_ - 1)];
+    b.addr = reinterpret_cast<uint64_t>(buffer(bid));
+    b.len = buf_size_;
+    b.bid = bid;
+    ++buf_tail_;
+    // The ring tail overlays the `resv` field of the first entry
+    std::atomic_ref<uint16_t>(buf_ring_[0].resv).store(buf_tail_, std::memory_order_release);
+}
+
+} // namespace cppcorn::core
+
+#endif
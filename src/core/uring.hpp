@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include <linux/io_uring.h>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace cppcorn::core {
+
+// Thin wrapper over the raw io_uring syscalls (no liburing dependency).
+// One instance per EventLoop; not thread-safe.
+class Uring {
+public:
+    explicit Uring(unsigned entries);
+    ~Uring();
+
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    // Returns a zeroed SQE. Flushes pending SQEs to the kernel if the ring is
+    // full, moving completions aside until it takes them. Throws if the
+    // kernel accepts none.
+    io_uring_sqe* get_sqe();
+
+    // Submits pending SQEs and waits for at least `wait_nr` completions,
+    // all in a single io_uring_enter call.
+    void submit_and_wait(unsigned wait_nr);
+
+    // Pops the next completion (those moved aside by get_sqe() first), or
+    // returns false if there are none.
+    bool next_cqe(io_uring_cqe& out);
+
+    // Provided-buffer ring (IORING_REGISTER_PBUF_RING). Reads submitted with
+    // IOSQE_BUFFER_SELECT pick a buffer only once data arrives.
+    bool setup_buffer_ring(uint16_t group, unsigned count, unsigned size);
+    bool has_buffer_ring() const { return buf_ring_ != nullptr; }
+    uint16_t buffer_group() const { return buf_group_; }
+    unsigned buffer_size() const { return buf_size_; }
+    char* buffer(uint16_t bid) { return buf_base_ + (size_t)bid * buf_size_; }
+    void recycle_buffer(uint16_t bid);
+
+private:
+    void enter(unsigned to_submit, unsigned wait_nr);
+    bool sq_full() const;
+    // Moves the CQ ring's completions to backlog_; returns how many
+    size_t stash_completions();
+
+    int ring_fd_ = -1;
+
+    // Submission queue
+    void* sq_ptr_ = nullptr;
+    size_t sq_size_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned* sq_array_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned sqe_tail_ = 0;   // Local tail, published on submit
+    unsigned to_submit_ = 0;
+
+    // Completion queue
+    void* cq_ptr_ = nullptr;
+    size_t cq_size_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    std::vector<io_uring_cqe> backlog_; // Reaped while the SQ was full
+    size_t backlog_pos_ = 0;
+
+    // Provided buffers
+    io_uring_buf* buf_ring_ = nullptr;
+    size_t buf_ring_size_ = 0;
+    unsigned buf_count_ = 0;
+    unsigned buf_size_ = 0;
+    uint16_t buf_group_ = 0;
+    uint16_t buf_tail_ = 0;
+    char* buf_base_ = nullptr;
+};
+
+} // namespace cppcorn::core
+
+#endif
@@ -0,0 +1,162 @@
+#include "access_log.hpp"
+#include "../core/metrics.hpp"
+#include <fmt/format.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <ctime>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace cppcorn::http {
+
+void AccessRecord::set_request(std::string_view m, std::string_view p) {
+    method_len = (uint8_t)std::min(m.size(), sizeof(method));
+    std::memcpy(method, m.data(), method_len);
+    path_len = (uint8_t)std::min(p.size(), sizeof(path));
+    std::memcpy(path, p.data(), path_len);
+}
+
+AccessLog::AccessLog(const std::string& path, double sample_rate) {
+    if (path == "-") {
+        file_ = stdout;
+        owns_file_ = false;
+    } else {
+        file_ = std::fopen(path.c_str(), "ab");
+        if (!file_) throw std::runtime_error("Cannot open access log " + path);
+        owns_file_ = true;
+    }
+    if (sample_rate >= 1) {
+        sample_threshold_ = std::numeric_limits<uint64_t>::max();
+    } else {
+        sample_threshold_ = sample_rate > 0
+            ? (uint64_t)(sample_rate * (double)std::numeric_limits<uint64_t>::max()) : 0;
+    }
+    drainer_ = std::thread([this] { drain_loop(); });
+}
+
+AccessLog::~AccessLog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    drainer_.join();
+    if (owns_file_) std::fclose(file_);
+}
+
+bool AccessLog::sample() {
+    if (sample_threshold_ == std::numeric_limits<uint64_t>::max()) return true;
+    // xorshift64*: cheap and good enough to pick lines
+    thread_local uint64_t state =
+        0x9E3779B97F4A7C15ull ^ (uint64_t)std::hash<std::thread::id>{}(std::this_thread::get_id());
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1Dull < sample_threshold_;
+}
+
+AccessLog::Ring& AccessLog::local_ring() {
+    thread_local AccessLog* owner = nullptr;
+    thread_local Ring* ring = nullptr;
+    if (owner != this) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ring = rings_.emplace_back(std::make_unique<Ring>()).get();
+        owner = this;
+    }
+    return *ring;
+}
+
+void AccessLog::submit(const AccessRecord& record) {
+    Ring& ring = local_ring();
+    size_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail - ring.head.load(std::memory_order_acquire) == RING_SIZE) {
+        core::Metrics::local().access_log_dropped.add();
+        return;
+    }
+    ring.slots[tail % RING_SIZE] = record;
+    ring.tail.store(tail + 1, std::memory_order_release);
+}
+
+// JSON string contents; paths are mostly printable already
+static void append_escaped(std::string& out, std::string_view s) {
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20 || c == 0x7f) {
+            fmt::format_to(std::back_inserter(out), "\\u{:04x}", (unsigned char)c);
+        } else {
+            out += c;
+        }
+    }
+}
+
+static void append_record(std::string& out, const AccessRecord& r) {
+    std::time_t t = (std::time_t)(r.time_us / 1000000);
+    std::tm tm{};
+#ifdef _WIN32
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+    fmt::format_to(std::back_inserter(out),
+                   "{{\"time\":\"{:04}-{:02}-{:02}T{:02}:{:02}:{:02}.{:03}Z\",\"method\":\"",
+                   tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+                   (r.time_us / 1000) % 1000);
+    append_escaped(out, std::string_view(r.method, r.method_len));
+    out += "\",\"path\":\"";
+    append_escaped(out, std::string_view(r.path, r.path_len));
+    fmt::format_to(std::back_inserter(out),
+                   "\",\"status\":{},\"bytes\":{},\"parse_us\":{},\"bridge_us\":{},\"write_us\":{}}}\n",
+                   r.status, r.bytes, r.parse_us, r.bridge_us, r.write_us);
+}
+
+bool AccessLog::drain_once(std::string& buf) {
+    std::vector<Ring*> rings;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& r : rings_) rings.push_back(r.get());
+    }
+
+    bool any = false, backlogged = false;
+    for (Ring* ring : rings) {
+        size_t head = ring->head.load(std::memory_order_relaxed);
+        size_t tail = ring->tail.load(std::memory_order_acquire);
+        if (head == tail) continue;
+        any = true;
+        backlogged |= tail - head >= RING_SIZE / 2;
+        for (; head != tail; ++head) {
+            append_record(buf, ring->slots[head % RING_SIZE]);
+            if (buf.size() >= 64 * 1024) {
+                std::fwrite(buf.data(), 1, buf.size(), file_);
+                buf.clear();
+            }
+        }
+        ring->head.store(head, std::memory_order_release);
+    }
+    if (!buf.empty()) {
+        std::fwrite(buf.data(), 1, buf.size(), file_);
+        buf.clear();
+    }
+    if (any) std::fflush(file_);
+    return backlogged;
+}
+
+void AccessLog::drain_loop() {
+    std::string buf;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        lock.unlock();
+        bool backlogged = drain_once(buf);
+        lock.lock();
+        // The loops never signal us: poll, unless a ring is filling faster
+        if (!backlogged) wake_.wait_for(lock, std::chrono::milliseconds(DRAIN_MS), [this] { return stop_; });
+    }
+    lock.unlock();
+    drain_once(buf);
+}
+
+} // namespace cppcorn::http
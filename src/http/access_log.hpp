@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace cppcorn::http {
+
+// One access log line, fixed-size so the loop never allocates to queue it.
+// Method and path are truncated to fit.
+struct AccessRecord {
+    int64_t time_us = 0; // Wall clock when the request's headers were in
+    uint64_t bytes = 0;  // Response bytes, headers included
+    uint32_t parse_us = 0;
+    uint32_t bridge_us = 0; // Admission, worker and the app, up to response start
+    uint32_t write_us = 0;  // Socket writes until the response was out
+    uint16_t status = 0;
+    uint8_t method_len = 0;
+    uint8_t path_len = 0;
+    char method[16];
+    char path[255];
+
+    void set_request(std::string_view m, std::string_view p);
+};
+
+// Process-wide access log. Loop threads push records into their own
+// single-producer ring; a background thread drains all rings and appends
+// them to the file as JSON lines, in batched writes. A full ring drops the
+// record (counted in the thread's metrics) rather than stall the loop.
+class AccessLog {
+public:
+    static constexpr size_t RING_SIZE = 4096; // Records per loop thread
+    static constexpr int DRAIN_MS = 50;       // Drain interval when idle
+
+    // "-" logs to stdout. Logs about `sample_rate` of requests (0 to 1).
+    // Throws if the file can't be opened.
+    AccessLog(const std::string& path, double sample_rate);
+    ~AccessLog();
+
+    AccessLog(const AccessLog&) = delete;
+    AccessLog& operator=(const AccessLog&) = delete;
+
+    // Whether to log the request starting now. Call from a loop thread.
+    bool sample();
+    // Queues `record`, or drops it if this thread's ring is full
+    void submit(const AccessRecord& record);
+
+private:
+    struct Ring {
+        std::atomic<size_t> head{0}; // Next to drain; written by the drainer
+        std::atomic<size_t> tail{0}; // Next to fill; written by the loop thread
+        AccessRecord slots[RING_SIZE];
+    };
+
+    Ring& local_ring();
+    void drain_loop();
+    // Writes out everything queued; true if some ring was half full
+    bool drain_once(std::string& buf);
+
+    std::FILE* file_;
+    bool owns_file_;
+    uint64_t sample_threshold_; // Compared against a 64-bit random draw
+
+    std::mutex mutex_; // Guards rings_ (registration) and stop_
+    std::vector<std::unique_ptr<Ring>> rings_;
+    bool stop_ = false;
+    std::condition_variable wake_;
+    std::thread drainer_;
+};
+
+} // namespace cppcorn::http
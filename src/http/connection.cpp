@@ -1,74 +1,536 @@
 #include "connection.hpp"
 #include "../asgi/bridge.hpp"
+#include "../core/timeout.hpp"
+#include "response_header.hpp"
+#include "websocket.hpp"
 #include <fmt/core.h>
+#include <array>
+#include <iterator>
 
 namespace cppcorn::http {
 
-// Demo: Global bridge instance (ugly but functional for prototype)
-extern asgi::Bridge* g_bridge;
+// Demo: Bridge of the current event loop thread (ugly but functional for prototype)
+extern thread_local asgi::Bridge* g_bridge;
 
-Connection::Connection(core::Socket socket) 
-    : socket_(std::move(socket)) {
-    read_buffer_.resize(8192);
+Connection::Connection(core::Socket socket, const ConnectionOptions& options)
+    : socket_(std::move(socket)), timeouts_(options.timeouts),
+      static_files_(options.static_files), cache_(options.cache), coalescer_(options.coalescer),
+      admission_(options.admission), metrics_path_(options.metrics_path),
+      metrics_(core::Metrics::local()), access_log_(options.access_log) {
+    metrics_.connections_active.add(1);
 }
 
-Connection::~Connection() {}
+Connection::~Connection() {
+    metrics_.connections_active.add(-1);
+    submit_logs(); // Whatever got out before the connection ended
+}
+
+std::chrono::milliseconds Connection::read_timeout() const {
+    if (!parser_.message_started()) return timeouts_.keep_alive;
+    if (parser_.headers_complete()) return timeouts_.body_read;
+
+    uint64_t now = core::EventLoop::instance().timers().now();
+    return std::chrono::milliseconds(header_deadline_ > now ? header_deadline_ - now : 0);
+}
 
 core::FireAndForget Connection::start() {
     socket_.set_non_blocking();
+    socket_.set_no_delay();
     try {
-        while (true) {
-            size_t n = co_await socket_.read(std::span(read_buffer_));
-            if (n == 0) break;
+        bool drop_body = false; // The app already responded to the request being read
+        bool keep_alive = true;
+
+        while (keep_alive) {
+            auto n = co_await core::with_timeout(
+                socket_.read_lent(input_), read_timeout(),
+                [this] { socket_.shutdown(); });
+            if (!n || *n == 0) {
+                // Timed out or closed; an idle keep-alive timing out is normal
+                if (!n && parser_.message_started()) metrics_.error(core::ErrorKind::Timeout);
+                break;
+            }
+            metrics_.bytes_in.add(*n);
 
-            parser_.feed(std::string_view(read_buffer_.data(), n));
+            // Dispatch every request in the read; a pipelining client can
+            // have several in one buffer
+            std::string_view data = input_.view(*n);
+            while (!data.empty()) {
+                if (!parser_.message_started()) {
+                    header_deadline_ = core::EventLoop::instance().timers().now() +
+                                       timeouts_.header_read.count();
+                }
+                bool had_headers = parser_.headers_complete();
+                uint64_t parse_start = had_headers ? 0 : core::EventLoop::monotonic_us();
+                size_t used;
+                try {
+                    used = parser_.feed(data);
+                } catch (const std::exception&) {
+                    metrics_.error(core::ErrorKind::Parse);
+                    throw;
+                }
+                data.remove_prefix(used);
+                if (!had_headers) parse_us_ += core::EventLoop::monotonic_us() - parse_start;
+                if (!parser_.headers_complete()) continue;
 
-            if (parser_.is_complete()) {
                 const auto& req = parser_.request();
-                fmt::print("Request: {} {}\n", req.method, req.path);
+                bool complete = parser_.is_complete();
+                std::unique_ptr<AccessRecord> log; // Joins the request's pipeline entry
+                if (!had_headers) {
+                    metrics_.requests.add();
+                    metrics_.parse_us.record(parse_us_);
+                    if (access_log_ && access_log_->sample()) {
+                        using namespace std::chrono;
+                        log = std::make_unique<AccessRecord>();
+                        log->time_us = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+                        log->parse_us = (uint32_t)parse_us_;
+                        log->set_request(req.method, req.path);
+                    }
+                    parse_us_ = 0;
+                }
+                uint64_t queue_us = 0;
+                // The request being read, once its headers are in; its body
+                // streams to the worker as it arrives
+                Pipelined* current = !pipeline_.empty() && !pipeline_.back().complete
+                                         ? &pipeline_.back() : nullptr;
 
-                if (g_bridge) {
+                if (!current && g_bridge && complete && is_websocket_upgrade(req)) {
+                    // Admission doesn't apply: a websocket would hold its
+                    // slot for as long as it stays open
+                    current = &pipeline_.emplace_back();
+                    drop_body = true; // Nothing follows but frames
+                    if (int status = websocket_handshake_error(req)) {
+                        refuse_upgrade(*current, status);
+                    } else {
+                        current->websocket_key = req.header("sec-websocket-key");
+                        current->exchange.emplace(*g_bridge);
+                        co_await g_bridge->open(*current->exchange, asgi::HttpScope{
+                            req.method, req.path, req.headers, {}, false, true});
+                    }
+                }
+                if (!current && !metrics_path_.empty() &&
+                    req.path.substr(0, req.path.find('?')) == metrics_path_) {
+                    current = &pipeline_.emplace_back();
+                    render_metrics(current->file);
+                    drop_body = true;
+                }
+#ifndef _WIN32
+                if (!current && static_files_) {
+                    // Static mounts never reach the workers; any body is dropped
+                    Pipelined& p = pipeline_.emplace_back();
+                    if (static_files_->respond(req, p.file)) {
+                        current = &p;
+                        drop_body = true;
+                    } else {
+                        pipeline_.pop_back();
+                    }
+                }
+#endif
+                bool cacheable = !current && cache_ && ResponseCache::eligible(req);
+                if (cacheable) {
+                    if (auto hit = cache_->lookup(req)) {
+                        current = &pipeline_.emplace_back();
+                        current->cached = std::move(hit);
+                        current->head = req.method == "HEAD";
+                        drop_body = true;
+                    }
+                }
+                if (g_bridge && !current) {
                     // Forward to ASGI
-                    nlohmann::json scope;
-                    scope["method"] = req.method;
-                    scope["path"] = req.path;
-                    scope["headers"] = nlohmann::json::array();
-                    for(auto& h : req.headers) {
-                        scope["headers"].push_back({h.first, h.second});
+                    current = &pipeline_.emplace_back();
+                    current->head = req.method == "HEAD";
+                    current->http10 = req.version_major == 1 && req.version_minor == 0;
+                    if (cacheable && !current->head) current->cache_key = ResponseCache::key_for(req);
+                    if (coalescer_ && complete && SingleFlight::eligible(req)) {
+                        current->flight = coalescer_->join(req, current->leads);
+                        if (!current->leads) current->replay = std::make_unique<OwnedRequest>(req);
+                    }
+                    if (!current->flight || current->leads) {
+                        // Waits while the workers are at their limit; nothing
+                        // is read meanwhile, so `req` stays valid
+                        uint64_t queued_at = core::EventLoop::monotonic_us();
+                        asgi::Admission::Permit permit;
+                        if (admission_) permit = co_await admission_->acquire();
+                        if (admission_ && !permit) {
+                            shed(*current);
+                            drop_body = true;
+                        } else {
+                            current->exchange.emplace(*g_bridge);
+                            if (current->leads) {
+                                current->exchange->observe(
+                                    [flight = current->flight](const asgi::HttpResponse* start,
+                                                               std::string_view body) {
+                                        flight->share(start, body);
+                                    });
+                            }
+                            co_await g_bridge->open(*current->exchange, asgi::HttpScope{
+                                req.method, req.path, req.headers, parser_.body(), !complete},
+                                std::move(permit));
+                            queue_us = core::EventLoop::monotonic_us() - queued_at;
+                            metrics_.queue_wait_us.record(queue_us);
+                        }
                     }
+                } else if (current && !drop_body && (!parser_.body().empty() || complete)) {
+                    // Waits while the app is behind, which stops our reads
+                    drop_body = !co_await current->exchange->send_body(parser_.body(), !complete);
+                }
+                if (log && current) {
+                    log->bridge_us = (uint32_t)queue_us;
+                    current->log = std::move(log);
+                }
+                parser_.clear_body();
+                if (!complete) continue;
 
-                    co_await g_bridge->send_request(scope);
-                    auto resp = co_await g_bridge->receive_response();
-                    
-                    // Parse response
-                    std::string body = resp.value("body", "");
-                    int status = resp.value("status", 200);
-                    
-                    co_await send_response(body, status);
+                if (current) {
+                    current->complete = true;
                 } else {
                     co_await send_response("No Worker Attached");
                 }
+                drop_body = false;
                 parser_.reset();
+                if (current && !current->websocket_key.empty()) {
+                    // The rest of the read is the client's first frames
+                    upgrade_input_.assign(data);
+                    break;
+                }
             }
+
+            // Everything in the read is parsed or copied: hand its buffer
+            // back before waiting on the app
+            input_.reset();
+            keep_alive = co_await relay_pipeline();
         }
     } catch (const std::exception& e) {
         fmt::print("Connection Error: {}\n", e.what());
+        metrics_.error(core::ErrorKind::Connection);
     }
     delete this;
 }
 
-core::Task<void> Connection::send_response(const std::string& body, int status) {
-    std::string response = fmt::format(
-        "HTTP/1.1 {} OK\r\n"
-        "Content-Length: {}\r\n"
-        "Content-Type: text/plain\r\n"
-        "Connection: keep-alive\r\n"
-        "\r\n"
-        "{}",
-        status, body.size(), body
-    );
+core::Task<bool> Connection::relay_pipeline() {
+    while (!pipeline_.empty() && pipeline_.front().complete) {
+        Pipelined& p = pipeline_.front();
+        // Responses that are ready together share a write, but finished
+        // ones aren't held back while waiting on the app
+        if (p.exchange && !p.exchange->ready() && !co_await flush()) co_return false;
+        uint64_t bytes_mark = sent_bytes_ + batched_bytes();
+        uint64_t write_mark = write_us_;
+        bool keep_alive = true;
+        if (p.exchange && !p.websocket_key.empty()) {
+            keep_alive = co_await relay_websocket(p);
+        } else if (p.exchange) {
+            keep_alive = co_await relay_response(p);
+        } else if (p.cached) {
+            send_cached(p);
+        } else if (p.flight) {
+            keep_alive = co_await follow(p);
+        } else {
+            p.status = p.file.status;
+            keep_alive = co_await send_static(p.file);
+        }
+        if (p.log) {
+            // Complete once the flush carrying its last bytes is done
+            p.log->status = (uint16_t)p.status;
+            p.log->bytes = sent_bytes_ + batched_bytes() - bytes_mark;
+            logged_.push_back({std::move(p.log), write_mark});
+        }
+        pipeline_.pop_front();
+        if (!keep_alive) {
+            co_await flush();
+            co_return false;
+        }
+    }
+    co_return co_await flush();
+}
+
+std::string& Connection::out_piece() {
+    if (out_count_ == out_.size()) out_.emplace_back();
+    Piece& piece = out_[out_count_++];
+    piece.data.clear();
+    piece.ref = {};
+    return piece.data;
+}
+
+void Connection::out_ref(std::string_view data) {
+    if (out_count_ == out_.size()) out_.emplace_back();
+    Piece& piece = out_[out_count_++];
+    piece.data.clear();
+    piece.ref = data;
+}
+
+size_t Connection::batched_bytes() const {
+    size_t total = 0;
+    for (size_t i = 0; i < out_count_; ++i) {
+        total += out_[i].ref.empty() ? out_[i].data.size() : out_[i].ref.size();
+    }
+    return total;
+}
+
+void Connection::send_cached(Pipelined& p) {
+    // Only the status line and Date are produced per hit; the rest is
+    // written straight out of the entry
+    const CachedResponse& r = *p.cached;
+    p.status = r.status;
+    ResponseHeader head(out_piece(), r.status);
+    out_ref(r.headers());
+    out_ref("Connection: keep-alive\r\n\r\n");
+    if (!p.head) out_ref(r.body());
+    out_holds_.push_back(std::move(p.cached));
+}
+
+core::Task<bool> Connection::follow(Pipelined& p) {
+    if (!p.flight->done) {
+        if (!co_await flush()) co_return false;
+        co_await p.flight->wait();
+    }
+    if (p.flight->response) {
+        p.cached = p.flight->response;
+        send_cached(p);
+        co_return true;
+    }
+
+    if (admission_ && !co_await flush()) co_return false;
+    uint64_t queued_at = core::EventLoop::monotonic_us();
+    asgi::Admission::Permit permit;
+    if (admission_) {
+        permit = co_await admission_->acquire();
+        if (!permit) {
+            shed(p);
+            co_return co_await send_static(p.file);
+        }
+    }
+    auto headers = p.replay->header_views();
+    p.exchange.emplace(*g_bridge);
+    co_await g_bridge->open(*p.exchange, asgi::HttpScope{
+        p.replay->method, p.replay->target, headers, {}, false}, std::move(permit));
+    uint64_t queue_us = core::EventLoop::monotonic_us() - queued_at;
+    metrics_.queue_wait_us.record(queue_us);
+    if (p.log) p.log->bridge_us += (uint32_t)queue_us;
+    co_return co_await relay_response(p);
+}
+
+void Connection::shed(Pipelined& p) {
+    // Answered at once, in its place in the pipeline
+    static constexpr std::string_view body = "Service Unavailable";
+    p.status = p.file.status = 503;
+    ResponseHeader head(p.file.header, 503);
+    head.add("Retry-After", "1");
+    head.add("Content-Type", "text/plain");
+    head.content_length(body.size());
+    head.finish(true);
+    if (!p.head) p.file.header += body;
+    if (p.leads) {
+        // Followers try for a slot of their own
+        p.flight->finish(nullptr);
+        p.flight.reset();
+        p.leads = false;
+    }
+}
+
+void Connection::refuse_upgrade(Pipelined& p, int status) {
+    std::string_view body = status == 426 ? "Upgrade Required" : "Bad Request";
+    p.status = p.file.status = status;
+    ResponseHeader head(p.file.header, status);
+    if (status == 426) head.add("Sec-WebSocket-Version", "13");
+    head.add("Content-Type", "text/plain");
+    head.content_length(body.size());
+    head.finish(true);
+    p.file.header += body;
+}
+
+void Connection::render_metrics(StaticResponse& r) {
+    std::string body = core::Metrics::render();
+    ResponseHeader head(r.header, 200);
+    head.add("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+    head.content_length(body.size());
+    head.finish(true);
+    r.header += body;
+}
+
+core::Task<bool> Connection::send_static(StaticResponse& r) {
+    out_piece().swap(r.header);
+    if (!r.file) co_return true; // Stays in the batch
+#ifdef _WIN32
+    co_return false; // Static mounts are POSIX-only
+#else
+    // The header shares a packet with the start of the file
+    if (!co_await flush(true)) co_return false;
+    uint64_t start = core::EventLoop::monotonic_us();
+    size_t n = co_await socket_.send_file(r.file->fd, r.offset, r.length);
+    count_write(n, start);
+    co_return n == r.length;
+#endif
+}
+
+core::Task<bool> Connection::flush(bool more) {
+    if (out_count_ == 0) {
+        submit_logs();
+        co_return true;
+    }
+    slices_.clear();
+    size_t total = 0;
+    for (size_t i = 0; i < out_count_; ++i) {
+        std::string_view piece = out_[i].ref.empty() ? std::string_view(out_[i].data) : out_[i].ref;
+        if (piece.empty()) continue;
+        slices_.push_back(core::Socket::slice(piece));
+        total += piece.size();
+    }
+    out_count_ = 0;
+    uint64_t start = core::EventLoop::monotonic_us();
+    size_t n = co_await socket_.write_vectored(std::span(slices_), more);
+    count_write(n, start);
+    out_holds_.clear();
+    submit_logs();
+    co_return n == total;
+}
+
+void Connection::count_write(size_t n, uint64_t start_us) {
+    uint64_t us = core::EventLoop::monotonic_us() - start_us;
+    metrics_.write_us.record(us);
+    metrics_.bytes_out.add(n);
+    write_us_ += us;
+    sent_bytes_ += n;
+}
+
+void Connection::submit_logs() {
+    for (auto& l : logged_) {
+        l.record->write_us = (uint32_t)(write_us_ - l.write_mark);
+        access_log_->submit(*l.record);
+    }
+    logged_.clear();
+}
+
+core::Task<bool> Connection::relay_response(Pipelined& p) {
+    asgi::Bridge::Exchange& exchange = *p.exchange;
+    asgi::HttpResponse start;
+    bool failed = false;
+    try {
+        start = co_await exchange.response_start();
+    } catch (const std::exception& e) {
+        fmt::print("Worker Error: {}\n", e.what());
+        failed = true;
+    }
+    if (failed) {
+        metrics_.error(core::ErrorKind::Worker);
+        p.status = 502;
+        co_return co_await send_response("Bad Gateway", 502);
+    }
+    co_return co_await relay_started(p, std::move(start));
+}
+
+core::Task<bool> Connection::relay_started(Pipelined& p, asgi::HttpResponse start) {
+    asgi::Bridge::Exchange& exchange = *p.exchange;
+    p.status = start.status;
+    uint64_t worker_us = exchange.response_time_us();
+    if (worker_us) metrics_.worker_us.record(worker_us);
+    if (p.log) p.log->bridge_us += (uint32_t)worker_us;
+
+    // Waiting for the first body message lets a single-message response go
+    // out with a Content-Length; streamed ones are chunked (or, for HTTP/1.0
+    // clients, delimited by closing the connection).
+    std::string chunk;
+    bool more = co_await exchange.response_body(chunk);
+    if (p.cache_key && !more && chunk.size() <= cache_->max_entry_bytes()) {
+        cache_->store(*p.cache_key, start, chunk);
+    }
+
+    bool bodiless = p.head || start.status < 200 ||
+                    start.status == 204 || start.status == 304;
+    bool has_length = false;
+    bool chunked = false;
+    bool keep_alive = true;
+
+    ResponseHeader head(out_piece(), start.status);
+    for (const auto& [name, value] : start.headers) {
+        if (iequals(name, "transfer-encoding") || iequals(name, "connection") ||
+            iequals(name, "date")) continue; // Ours to set
+        if (iequals(name, "content-length")) has_length = true;
+        head.add(name, value);
+    }
+    if (!bodiless && !has_length) {
+        if (!more) {
+            head.content_length(chunk.size());
+        } else if (!p.http10) {
+            head.add("Transfer-Encoding", "chunked");
+            chunked = true;
+        } else {
+            keep_alive = false;
+        }
+    }
+    head.finish(keep_alive);
+
+    // Body pieces join the batch as they arrive; a streamed response is
+    // written out piece by piece
+    while (true) {
+        if (!bodiless && !chunk.empty()) {
+            if (chunked) fmt::format_to(std::back_inserter(out_piece()), "{:x}\r\n", chunk.size());
+            out_piece().swap(chunk); // The piece's old storage comes back for reuse
+            if (chunked) out_piece() = "\r\n";
+        }
+        if (!more) {
+            if (chunked) out_piece() = "0\r\n\r\n";
+            break;
+        }
+        if (!co_await flush()) co_return false;
+        more = co_await exchange.response_body(chunk);
+    }
+    co_return keep_alive;
+}
+
+core::Task<bool> Connection::relay_websocket(Pipelined& p) {
+    asgi::Bridge::Exchange& exchange = *p.exchange;
+    asgi::HttpResponse start;
+    bool failed = false;
+    try {
+        start = co_await exchange.response_start();
+    } catch (const std::exception& e) {
+        fmt::print("Worker Error: {}\n", e.what());
+        failed = true;
+    }
+    if (failed) {
+        metrics_.error(core::ErrorKind::Worker);
+        p.status = 502;
+        co_await send_response("Bad Gateway", 502);
+        co_return false;
+    }
+    if (start.status != 101) {
+        // Refused by the app: its response goes out as for any request
+        co_await relay_started(p, std::move(start));
+        co_return false;
+    }
+    p.status = 101;
+    uint64_t worker_us = exchange.response_time_us();
+    if (worker_us) metrics_.worker_us.record(worker_us);
+    if (p.log) p.log->bridge_us += (uint32_t)worker_us;
+
+    ResponseHeader head(out_piece(), 101);
+    for (const auto& [name, value] : start.headers) {
+        if (iequals(name, "connection") || iequals(name, "upgrade") || iequals(name, "date") ||
+            iequals(name, "sec-websocket-accept") || iequals(name, "content-length") ||
+            iequals(name, "transfer-encoding")) continue; // Ours to set
+        head.add(name, value);
+    }
+    head.add("Sec-WebSocket-Accept", websocket_accept(p.websocket_key));
+    head.finish_upgrade("websocket");
+    if (!co_await flush()) co_return false;
+
+    WebSocketSession session(socket_, exchange, timeouts_.websocket_ping);
+    co_await session.run(std::move(upgrade_input_));
+    co_return false;
+}
+
+core::Task<bool> Connection::send_response(std::string_view body, int status) {
+    if (!co_await flush()) co_return false; // Keep responses in order
+
+    ResponseHeader head(header_buf_, status);
+    head.add("Content-Type", "text/plain");
+    head.content_length(body.size());
+    head.finish(true);
 
-    co_await socket_.write(std::span(response.data(), response.size()));
+    std::array slices{core::Socket::slice(header_buf_), core::Socket::slice(body)};
+    uint64_t start = core::EventLoop::monotonic_us();
+    size_t n = co_await socket_.write_vectored(std::span(slices));
+    count_write(n, start);
+    co_return n == header_buf_.size() + body.size();
 }
 
 } // namespace cppcorn::http
@@ -3,25 +3,147 @@
 #include "../core/socket.hpp"
 #include "../core/coroutine.hpp"
 #include "parser.hpp"
+#include "static_files.hpp"
+#include "response_cache.hpp"
+#include "single_flight.hpp"
+#include "access_log.hpp"
+#include "../asgi/bridge.hpp"
+#include "../core/metrics.hpp"
 #include <span>
 #include <vector>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <chrono>
 
 namespace cppcorn::http {
 
+struct ConnectionTimeouts {
+    // Idle time allowed between requests on a keep-alive connection
+    std::chrono::milliseconds keep_alive{5000};
+    // Total time from a request's first byte to the end of its headers
+    // (absolute, so a slow-loris trickle can't keep extending it)
+    std::chrono::milliseconds header_read{10000};
+    // Max gap between body reads once headers are in
+    std::chrono::milliseconds body_read{30000};
+    // Keepalive ping interval on an idle websocket (0: off)
+    std::chrono::milliseconds websocket_ping{20000};
+};
+
+// What a connection shares with its server
+struct ConnectionOptions {
+    ConnectionTimeouts timeouts;
+    StaticFiles* static_files = nullptr; // The loop thread's static mounts
+    ResponseCache* cache = nullptr;      // Shared by all loop threads
+    SingleFlight* coalescer = nullptr;   // The loop thread's, if coalescing
+    asgi::Admission* admission = nullptr; // The loop thread's limit on worker calls
+    std::string_view metrics_path;       // Served natively if set
+    AccessLog* access_log = nullptr;     // Shared by all loop threads
+};
+
 class Connection {
 public:
-    explicit Connection(core::Socket socket);
+    explicit Connection(core::Socket socket, const ConnectionOptions& options = {});
     ~Connection();
 
     // The main coroutine for handling this client
     core::FireAndForget start();
 
 private:
-    core::Task<void> send_response(const std::string& body, int status = 200);
+    // A request handed to a worker whose response hasn't been written yet.
+    // Pipelined requests are all dispatched as soon as they are parsed; their
+    // responses go out in request order.
+    struct Pipelined {
+        std::optional<asgi::Bridge::Exchange> exchange; // Forwarded to a worker,
+        StaticResponse file;                            // or answered here,
+        std::shared_ptr<const CachedResponse> cached;   // or from the cache,
+        std::shared_ptr<Flight> flight;                 // or shared with others
+        std::optional<ResponseCache::Key> cache_key;    // Miss to store under
+        std::unique_ptr<OwnedRequest> replay;           // Follower's request
+        std::unique_ptr<AccessRecord> log;              // Set if sampled for the access log
+        std::string websocket_key;                      // Set for a websocket upgrade
+        int status = 0;        // Of the response, once relayed
+        bool leads = false;    // This request's exchange finishes `flight`
+        bool complete = false; // Whole request (body included) read
+        bool head = false;
+        bool http10 = false;
+
+        Pipelined() = default;
+        Pipelined(const Pipelined&) = delete;
+        Pipelined& operator=(const Pipelined&) = delete;
+        ~Pipelined() {
+            // Never leave followers waiting, whatever happened to us
+            if (flight && leads) flight->finish(nullptr);
+        }
+    };
+
+    // Writes a plain-text response of our own (after anything batched)
+    core::Task<bool> send_response(std::string_view body, int status = 200);
+    // Relays the responses of the complete requests at the front of the
+    // pipeline. Returns false if the connection can't be reused.
+    core::Task<bool> relay_pipeline();
+    // Batches the worker's response, streaming it out if it comes in
+    // pieces. Returns false if the connection can't be reused afterwards.
+    core::Task<bool> relay_response(Pipelined& p);
+    core::Task<bool> relay_started(Pipelined& p, asgi::HttpResponse start);
+    // Completes the handshake if the app accepts, then runs the websocket
+    // until it closes. Always returns false: the connection is done.
+    core::Task<bool> relay_websocket(Pipelined& p);
+    // Turns `p` into a refusal of a malformed upgrade
+    void refuse_upgrade(Pipelined& p, int status);
+    core::Task<bool> send_static(StaticResponse& r);
+    void send_cached(Pipelined& p);
+    // Waits for the flight `p` follows, then sends its shared response or,
+    // if there is none, asks a worker itself
+    core::Task<bool> follow(Pipelined& p);
+    // Turns `p` into a 503 with Retry-After: the workers are over capacity
+    void shed(Pipelined& p);
+    // Fills `r` with the scrape of all threads' metrics
+    static void render_metrics(StaticResponse& r);
+    // Output batch: pieces are gathered into one vectored write. A piece is
+    // either owned or a view into memory that outlives the batch.
+    std::string& out_piece();
+    void out_ref(std::string_view data);
+    size_t batched_bytes() const;
+    core::Task<bool> flush(bool more = false);
+    // Accounts for a socket write that started at `start_us`
+    void count_write(size_t n, uint64_t start_us);
+    // Hands the access log the records whose responses are now written
+    void submit_logs();
+    std::chrono::milliseconds read_timeout() const;
     
     core::Socket socket_;
+    ConnectionTimeouts timeouts_;
+    StaticFiles* static_files_;
+    ResponseCache* cache_;
+    SingleFlight* coalescer_;
+    asgi::Admission* admission_;
+    std::string_view metrics_path_;
+    core::Metrics& metrics_;       // This loop thread's
+    uint64_t parse_us_ = 0;        // Spent on the current request's headers
+    AccessLog* access_log_;
+    uint64_t sent_bytes_ = 0;      // Totals over the connection, for the access log
+    uint64_t write_us_ = 0;
+    struct Logged {
+        std::unique_ptr<AccessRecord> record;
+        uint64_t write_mark; // write_us_ when its response started
+    };
+    std::vector<Logged> logged_;   // Relayed, waiting on the flush that sends them
+    uint64_t header_deadline_ = 0; // Loop time (ms) the current headers must be in by
     Parser parser_;
-    std::vector<char> read_buffer_;
+    core::ReadBuffer input_;       // Lent by the socket until the read is parsed
+    std::deque<Pipelined> pipeline_;
+    struct Piece {
+        std::string data;
+        std::string_view ref; // Used instead of data if set
+    };
+    std::vector<Piece> out_;        // Reused across batches
+    size_t out_count_ = 0;          // Pieces in the current batch
+    std::vector<std::shared_ptr<const CachedResponse>> out_holds_; // Referenced by the batch
+    std::vector<core::Socket::IoSlice> slices_;
+    std::string header_buf_;        // send_response's header block
+    std::string upgrade_input_;     // Read past a websocket handshake
 };
 
 } // namespace cppcorn::http
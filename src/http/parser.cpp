@@ -1,14 +1,69 @@
 #include "parser.hpp"
 #include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
 
 namespace cppcorn::http {
 
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower((unsigned char)x) == std::tolower((unsigned char)y);
+           });
+}
+
+std::string_view Request::header(std::string_view name) const {
+    for (const auto& [n, v] : headers) {
+        if (iequals(n, name)) return v;
+    }
+    return {};
+}
+
+std::string_view TokenArena::concat(std::string_view a, std::string_view b) {
+    if (block_ < blocks_.size()) {
+        Block& cur = blocks_[block_];
+        char* top = cur.data.get() + used_;
+        if (!a.empty() && a.data() + a.size() == top && cur.size - used_ >= b.size()) {
+            // Growing the newest token, e.g. one trickling in a byte at a time
+            std::memcpy(top, b.data(), b.size());
+            used_ += b.size();
+            return std::string_view(a.data(), a.size() + b.size());
+        }
+    }
+
+    size_t n = a.size() + b.size();
+    while (block_ < blocks_.size() && blocks_[block_].size - used_ < n) {
+        ++block_;
+        used_ = 0;
+    }
+    if (block_ == blocks_.size()) {
+        // Doubling keeps a long token that keeps growing at O(n) copying
+        size_t size = std::max(n * 2, BLOCK_BYTES);
+        blocks_.push_back({std::make_unique<char[]>(size), size});
+        used_ = 0;
+    }
+    char* p = blocks_[block_].data.get() + used_;
+    std::memcpy(p, a.data(), a.size());
+    std::memcpy(p + a.size(), b.data(), b.size());
+    used_ += n;
+    return std::string_view(p, n);
+}
+
+bool TokenArena::owns(std::string_view s) const {
+    for (const auto& b : blocks_) {
+        if (s.data() >= b.data.get() && s.data() < b.data.get() + b.size) return true;
+    }
+    return false;
+}
+
 Parser::Parser() {
     llhttp_settings_init(&settings_);
     settings_.on_message_begin = on_message_begin;
     settings_.on_url = on_url;
     settings_.on_header_field = on_header_field;
     settings_.on_header_value = on_header_value;
+    settings_.on_header_value_complete = on_header_value_complete;
     settings_.on_headers_complete = on_headers_complete;
     settings_.on_body = on_body;
     settings_.on_message_complete = on_message_complete;
@@ -22,71 +77,108 @@ Parser::~Parser() {}
 void Parser::reset() {
     llhttp_reset(&parser_);
     complete_ = false;
-    curr_req_ = Request{};
+    started_ = false;
+    headers_complete_ = false;
+    // Keep the header vector's and arena's storage for the next request
+    curr_req_.method = {};
+    curr_req_.path = {};
+    curr_req_.headers.clear();
+    field_ = {};
+    value_ = {};
+    arena_.reset();
+    body_.clear();
 }
 
-void Parser::feed(std::string_view data) {
+size_t Parser::feed(std::string_view data) {
     enum llhttp_errno err = llhttp_execute(&parser_, data.data(), data.size());
+    if (err == HPE_PAUSED) {
+        // on_message_complete paused us right after the message
+        return llhttp_get_error_pos(&parser_) - data.data();
+    }
     if (err != HPE_OK) {
         throw std::runtime_error(std::string("HTTP Parse Error: ") + llhttp_errno_name(err));
     }
+    if (started_ && !headers_complete_) spill();
+    return data.size();
+}
+
+void Parser::append(std::string_view& token, const char* at, size_t length) {
+    if (token.empty()) {
+        token = std::string_view(at, length);
+    } else if (token.data() + token.size() == at) {
+        token = std::string_view(token.data(), token.size() + length);
+    } else {
+        token = arena_.concat(token, std::string_view(at, length));
+    }
+}
+
+void Parser::spill() {
+    // Headers are incomplete and the caller is about to reuse its buffer.
+    // Only views still pointing into that buffer are copied, so a request
+    // trickling in costs each byte one copy.
+    auto keep = [this](std::string_view& v) {
+        if (!v.empty() && !arena_.owns(v)) v = arena_.concat(v, {});
+    };
+    keep(curr_req_.path);
+    for (auto& [name, value] : curr_req_.headers) {
+        keep(name);
+        keep(value);
+    }
+    keep(field_);
+    keep(value_);
 }
 
 int Parser::on_message_begin(llhttp_t* p) {
+    Parser* self = (Parser*)p->data;
+    self->started_ = true;
     return 0;
 }
 
 int Parser::on_url(llhttp_t* p, const char* at, size_t length) {
     Parser* self = (Parser*)p->data;
-    self->curr_req_.path.append(at, length);
+    self->append(self->curr_req_.path, at, length);
     return 0;
 }
 
 int Parser::on_header_field(llhttp_t* p, const char* at, size_t length) {
     Parser* self = (Parser*)p->data;
-    if (!self->curr_req_.current_header_value.empty()) {
-        // flush previous header
-        self->curr_req_.headers.emplace_back(
-            std::move(self->curr_req_.current_header_field),
-            std::move(self->curr_req_.current_header_value)
-        );
-        self->curr_req_.current_header_field.clear();
-        self->curr_req_.current_header_value.clear();
-    }
-    self->curr_req_.current_header_field.append(at, length);
+    self->append(self->field_, at, length);
     return 0;
 }
 
 int Parser::on_header_value(llhttp_t* p, const char* at, size_t length) {
     Parser* self = (Parser*)p->data;
-    self->curr_req_.current_header_value.append(at, length);
+    self->append(self->value_, at, length);
+    return 0;
+}
+
+int Parser::on_header_value_complete(llhttp_t* p) {
+    Parser* self = (Parser*)p->data;
+    self->curr_req_.headers.emplace_back(self->field_, self->value_);
+    self->field_ = {};
+    self->value_ = {};
     return 0;
 }
 
 int Parser::on_headers_complete(llhttp_t* p) {
     Parser* self = (Parser*)p->data;
-    if (!self->curr_req_.current_header_field.empty()) {
-        self->curr_req_.headers.emplace_back(
-            std::move(self->curr_req_.current_header_field),
-            std::move(self->curr_req_.current_header_value)
-        );
-    }
     self->curr_req_.method = llhttp_method_name((llhttp_method_t)p->method);
     self->curr_req_.version_major = p->http_major;
     self->curr_req_.version_minor = p->http_minor;
+    self->headers_complete_ = true;
     return 0;
 }
 
 int Parser::on_body(llhttp_t* p, const char* at, size_t length) {
     Parser* self = (Parser*)p->data;
-    self->curr_req_.body.append(at, length);
+    self->body_.append(at, length);
     return 0;
 }
 
 int Parser::on_message_complete(llhttp_t* p) {
     Parser* self = (Parser*)p->data;
     self->complete_ = true;
-    return 0;
+    return HPE_PAUSED; // Leave any pipelined bytes for the next request
 }
 
 } // namespace cppcorn::http
@@ -3,22 +3,49 @@
 #include <llhttp.h>
 #include <string>
 #include <vector>
+#include <memory>
 #include <functional>
 #include <string_view>
 
 namespace cppcorn::http {
 
+// Method, path and headers are views into the buffer handed to
+// Parser::feed(), or into the parser's arena for tokens that were split
+// across two feeds. They stay valid until the parser is fed again after the
+// headers are complete, or reset.
 struct Request {
-    std::string method;
-    std::string path;
+    std::string_view method; // Static string from llhttp
+    std::string_view path;
     int version_major = 1;
     int version_minor = 1;
-    std::vector<std::pair<std::string, std::string>> headers;
-    std::string body;
-    
-    // Helper to track state during parsing
-    std::string current_header_field;
-    std::string current_header_value;
+    std::vector<std::pair<std::string_view, std::string_view>> headers;
+
+    // Value of the first header named `name` (any case), or empty
+    std::string_view header(std::string_view name) const;
+};
+
+// ASCII case-insensitive comparison, for header names and tokens
+bool iequals(std::string_view a, std::string_view b);
+
+// Bump allocator for tokens that span two reads. Blocks are kept across
+// requests, so a keep-alive connection allocates at most once.
+class TokenArena {
+public:
+    // Returns a stable copy of a followed by b. If `a` is the last token
+    // handed out, b is appended in place.
+    std::string_view concat(std::string_view a, std::string_view b);
+    bool owns(std::string_view s) const;
+    void reset() { block_ = 0; used_ = 0; }
+
+private:
+    static constexpr size_t BLOCK_BYTES = 4096;
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    std::vector<Block> blocks_;
+    size_t block_ = 0; // Current block
+    size_t used_ = 0;  // Bytes used in it
 };
 
 class Parser {
@@ -31,11 +58,23 @@ public:
     // For ASGI, we probably want to stream events.
     // For now, let's buffer the request for simplicity or emit callbacks.
     
-    // Feed data. Returns consumed bytes or throws on error.
-    void feed(std::string_view data);
+    // Feed data. Returns consumed bytes or throws on error. Parsing stops
+    // after a complete message; the rest of `data` belongs to the next one
+    // and must be fed again after reset(). Until the headers are complete,
+    // the caller may reuse the buffer behind `data` once this returns.
+    size_t feed(std::string_view data);
     
     // Check if request is ready
     bool is_complete() const { return complete_; }
+
+    // Body bytes parsed since the last clear_body(). The body is streamed
+    // rather than accumulated in the Request.
+    std::string_view body() const { return body_; }
+    void clear_body() { body_.clear(); }
+
+    // Progress of the current message, used for read timeouts
+    bool message_started() const { return started_; }
+    bool headers_complete() const { return headers_complete_; }
     
     const Request& request() const { return curr_req_; }
     void reset();
@@ -45,15 +84,28 @@ private:
     static int on_url(llhttp_t* p, const char* at, size_t length);
     static int on_header_field(llhttp_t* p, const char* at, size_t length);
     static int on_header_value(llhttp_t* p, const char* at, size_t length);
+    static int on_header_value_complete(llhttp_t* p);
     static int on_headers_complete(llhttp_t* p);
     static int on_body(llhttp_t* p, const char* at, size_t length);
     static int on_message_complete(llhttp_t* p);
 
+    // Extends `token` with the next slice of it, copying only if the two
+    // aren't adjacent in memory
+    void append(std::string_view& token, const char* at, size_t length);
+    // Moves every view into the caller's buffer into the arena
+    void spill();
+
     llhttp_t parser_;
     llhttp_settings_t settings_;
     
     Request curr_req_;
+    std::string_view field_; // Header being parsed
+    std::string_view value_;
+    TokenArena arena_;
+    std::string body_;
     bool complete_ = false;
+    bool started_ = false;
+    bool headers_complete_ = false;
 };
 
 } // namespace cppcorn::http
@@ -0,0 +1,224 @@
+#include "response_cache.hpp"
+#include "response_header.hpp"
+#include "../core/event_loop.hpp"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <functional>
+
+namespace cppcorn::http {
+
+static std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+// Calls fn(name, value) for each directive of a comma-separated list such
+// as Cache-Control; value is empty for bare directives
+template <typename Fn>
+static void for_each_directive(std::string_view list, Fn fn) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view item = trim(list.substr(0, comma));
+        size_t eq = item.find('=');
+        std::string_view value;
+        if (eq != std::string_view::npos) {
+            value = trim(item.substr(eq + 1));
+            if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+                value = value.substr(1, value.size() - 2);
+            }
+            item = trim(item.substr(0, eq));
+        }
+        if (!item.empty()) fn(item, value);
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+}
+
+static bool has_directive(std::string_view list, std::string_view name) {
+    bool found = false;
+    for_each_directive(list, [&](std::string_view d, std::string_view) {
+        if (iequals(d, name)) found = true;
+    });
+    return found;
+}
+
+// Seconds a shared cache may serve the response for, or 0
+static uint64_t shared_ttl(std::string_view cache_control) {
+    int64_t max_age = -1, s_maxage = -1;
+    bool forbidden = false;
+    for_each_directive(cache_control, [&](std::string_view d, std::string_view v) {
+        auto seconds = [&](int64_t& out) {
+            int64_t n = 0;
+            auto r = std::from_chars(v.data(), v.data() + v.size(), n);
+            if (r.ec == std::errc() && n >= 0) out = n;
+        };
+        if (iequals(d, "private") || iequals(d, "no-store") || iequals(d, "no-cache")) forbidden = true;
+        else if (iequals(d, "max-age")) seconds(max_age);
+        else if (iequals(d, "s-maxage")) seconds(s_maxage);
+    });
+    if (forbidden) return 0;
+    int64_t ttl = s_maxage >= 0 ? s_maxage : max_age;
+    return ttl > 0 ? (uint64_t)ttl : 0;
+}
+
+static std::string lowercase(std::string_view s) {
+    std::string out(s);
+    for (char& c : out) c = (char)std::tolower((unsigned char)c);
+    return out;
+}
+
+std::shared_ptr<CachedResponse> CachedResponse::make(const asgi::HttpResponse& response,
+                                                    std::string_view body) {
+    auto entry = std::make_shared<CachedResponse>();
+    entry->status = response.status;
+    std::string& bytes = entry->bytes;
+    for (const auto& [name, value] : response.headers) {
+        // Framing and Date are the server's, added per response
+        if (iequals(name, "transfer-encoding") || iequals(name, "connection") ||
+            iequals(name, "content-length") || iequals(name, "date")) {
+            continue;
+        }
+        bytes += name;
+        bytes += ": ";
+        bytes += value;
+        bytes += "\r\n";
+    }
+    if (response.status != 204 && response.status != 304) {
+        char digits[24];
+        auto end = std::to_chars(digits, digits + sizeof(digits), body.size()).ptr;
+        bytes += "Content-Length: ";
+        bytes.append(digits, end);
+        bytes += "\r\n";
+    }
+    entry->body_offset = bytes.size();
+    bytes += body;
+    return entry;
+}
+
+ResponseCache::ResponseCache(size_t max_bytes) : shard_bytes_(max_bytes / SHARDS) {}
+
+ResponseCache::Shard& ResponseCache::shard_for(std::string_view target) {
+    return shards_[std::hash<std::string_view>{}(target) % SHARDS];
+}
+
+bool ResponseCache::eligible(const Request& req) {
+    return (req.method == "GET" || req.method == "HEAD") && req.header("Authorization").empty();
+}
+
+ResponseCache::Key ResponseCache::key_for(const Request& req) {
+    Key key;
+    key.target = req.path;
+    key.headers.reserve(req.headers.size());
+    for (const auto& [name, value] : req.headers) {
+        key.headers.emplace_back(lowercase(name), std::string(value));
+    }
+    return key;
+}
+
+std::shared_ptr<const CachedResponse> ResponseCache::lookup(const Request& req) {
+    // The client asked for a fresh answer: go to the app (and store that)
+    if (has_directive(req.header("Cache-Control"), "no-cache") ||
+        has_directive(req.header("Pragma"), "no-cache")) {
+        return nullptr;
+    }
+
+    Shard& shard = shard_for(req.path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(req.path);
+    if (it == shard.index.end()) return nullptr;
+
+    Node& node = *it->second;
+    uint64_t now = core::EventLoop::monotonic_ms();
+    for (const auto& variant : node.variants) {
+        if (variant.response->expires_ms <= now) continue;
+        bool match = true;
+        for (size_t i = 0; i < node.vary.size() && match; ++i) {
+            match = req.header(node.vary[i]) == variant.values[i];
+        }
+        if (match) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return variant.response;
+        }
+    }
+    return nullptr;
+}
+
+void ResponseCache::store(const Key& key, const asgi::HttpResponse& response, std::string_view body) {
+    switch (response.status) {
+        case 200: case 203: case 204: case 300: case 301: case 308: case 404: case 410: break;
+        default: return;
+    }
+
+    uint64_t ttl = 0;
+    std::vector<std::string> vary;
+    for (const auto& [name, value] : response.headers) {
+        if (iequals(name, "set-cookie")) return; // Per-client
+        if (iequals(name, "cache-control")) ttl = shared_ttl(value);
+        if (iequals(name, "vary")) {
+            bool any = false;
+            for_each_directive(value, [&](std::string_view d, std::string_view) {
+                if (d == "*") any = true;
+                vary.push_back(lowercase(d));
+            });
+            if (any) return;
+        }
+    }
+    if (ttl == 0) return;
+
+    auto entry = CachedResponse::make(response, body);
+    entry->expires_ms = core::EventLoop::monotonic_ms() + ttl * 1000;
+
+    size_t size = entry->bytes.size() + key.target.size();
+    if (size > max_entry_bytes()) return;
+
+    Variant variant;
+    variant.response = std::move(entry);
+    for (const auto& name : vary) {
+        auto h = std::find_if(key.headers.begin(), key.headers.end(),
+                              [&](const auto& kv) { return kv.first == name; });
+        variant.values.push_back(h != key.headers.end() ? h->second : std::string());
+    }
+
+    Shard& shard = shard_for(key.target);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key.target);
+    if (it == shard.index.end()) {
+        shard.lru.emplace_front();
+        shard.lru.front().target = key.target;
+        it = shard.index.emplace(shard.lru.front().target, shard.lru.begin()).first;
+    } else {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    }
+    Node& node = *it->second;
+
+    // A different Vary list makes the old variants unreachable
+    if (node.vary != vary) {
+        node.vary = std::move(vary);
+        node.variants.clear();
+    }
+    uint64_t now = core::EventLoop::monotonic_ms();
+    std::erase_if(node.variants, [&](const Variant& v) {
+        return v.values == variant.values || v.response->expires_ms <= now;
+    });
+    if (node.variants.size() >= MAX_VARIANTS) node.variants.erase(node.variants.begin());
+    node.variants.push_back(std::move(variant));
+
+    shard.bytes -= node.bytes;
+    node.bytes = node.target.size();
+    for (const auto& v : node.variants) node.bytes += v.response->bytes.size();
+    shard.bytes += node.bytes;
+
+    while (shard.bytes > shard_bytes_ && !shard.lru.empty()) {
+        erase(shard, std::prev(shard.lru.end()));
+    }
+}
+
+void ResponseCache::erase(Shard& shard, std::list<Node>::iterator it) {
+    shard.bytes -= it->bytes;
+    shard.index.erase(it->target);
+    shard.lru.erase(it);
+}
+
+} // namespace cppcorn::http
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "parser.hpp"
+#include "../asgi/protocol.hpp"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cppcorn::http {
+
+// A stored app response, immutable once inserted. `bytes` is the app's
+// header lines (Content-Length included, no status line, Date or
+// Connection) followed by the body, so a hit is written straight from it.
+struct CachedResponse {
+    int status = 200;
+    std::string bytes;
+    size_t body_offset = 0;
+    uint64_t expires_ms = 0; // EventLoop::monotonic_ms
+
+    std::string_view headers() const { return std::string_view(bytes).substr(0, body_offset); }
+    std::string_view body() const { return std::string_view(bytes).substr(body_offset); }
+
+    // Serializes a complete app response (framing headers and Date dropped)
+    static std::shared_ptr<CachedResponse> make(const asgi::HttpResponse& response, std::string_view body);
+};
+
+// Shared cache of GET responses that the app marked fresh with
+// Cache-Control (s-maxage or max-age; not private, no-store or no-cache).
+// Entries are keyed by request target plus the values of the response's
+// Vary headers. Keys hash to one of SHARDS shards, each an LRU with its own
+// lock and an equal share of the memory budget, so loop threads rarely
+// contend and a hit holds a lock only to take a reference.
+class ResponseCache {
+public:
+    static constexpr size_t SHARDS = 16;
+    static constexpr size_t MAX_VARIANTS = 8; // Per target
+
+    explicit ResponseCache(size_t max_bytes);
+
+    // Whether `req` may be answered from (and its response stored in) the
+    // cache at all: GET/HEAD without credentials
+    static bool eligible(const Request& req);
+    // Fresh entry for `req`, or null. Honours request no-cache.
+    std::shared_ptr<const CachedResponse> lookup(const Request& req);
+
+    // What store() needs from the request, captured while its views are valid
+    struct Key {
+        std::string target;
+        std::vector<std::pair<std::string, std::string>> headers; // Lowercased names
+    };
+    static Key key_for(const Request& req);
+
+    // Stores a complete response if the app allows it. `body` is the whole
+    // body (single message).
+    void store(const Key& key, const asgi::HttpResponse& response, std::string_view body);
+
+    size_t max_entry_bytes() const { return shard_bytes_ / 8; }
+
+private:
+    struct Variant {
+        std::vector<std::string> values; // One per Vary name
+        std::shared_ptr<const CachedResponse> response;
+    };
+    struct Node {
+        std::string target;
+        std::vector<std::string> vary; // Lowercased header names
+        std::vector<Variant> variants;
+        size_t bytes = 0;
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::list<Node> lru; // Most recently used first
+        std::unordered_map<std::string_view, std::list<Node>::iterator> index; // Views into Node::target
+        size_t bytes = 0;
+    };
+
+    Shard& shard_for(std::string_view target);
+    void erase(Shard& shard, std::list<Node>::iterator it);
+
+    size_t shard_bytes_;
+    Shard shards_[SHARDS];
+};
+
+} // namespace cppcorn::http
@@ -0,0 +1,165 @@
+#include "response_header.hpp"
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace cppcorn::http {
+
+const char* status_reason(int status) {
+    switch (status) {
+        case 100: return "Continue";
+        case 101: return "Switching Protocols";
+        case 200: return "OK";
+        case 201: return "Created";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 206: return "Partial Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 303: return "See Other";
+        case 304: return "Not Modified";
+        case 307: return "Temporary Redirect";
+        case 308: return "Permanent Redirect";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 409: return "Conflict";
+        case 410: return "Gone";
+        case 411: return "Length Required";
+        case 412: return "Precondition Failed";
+        case 413: return "Content Too Large";
+        case 414: return "URI Too Long";
+        case 415: return "Unsupported Media Type";
+        case 416: return "Range Not Satisfiable";
+        case 422: return "Unprocessable Content";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default: return status < 400 ? "OK" : "Error";
+    }
+}
+
+namespace {
+
+constexpr int MIN_STATUS = 100;
+constexpr int MAX_STATUS = 599;
+
+// "HTTP/1.1 200 OK\r\n" for every valid status
+const std::array<std::string, MAX_STATUS - MIN_STATUS + 1>& status_lines() {
+    static const auto lines = [] {
+        std::array<std::string, MAX_STATUS - MIN_STATUS + 1> t;
+        for (int s = MIN_STATUS; s <= MAX_STATUS; ++s) {
+            t[s - MIN_STATUS] = "HTTP/1.1 " + std::to_string(s) + " " + status_reason(s) + "\r\n";
+        }
+        return t;
+    }();
+    return lines;
+}
+
+const char* const DAYS[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+const char* const MONTHS[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                              "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+// "Date: <IMF-fixdate>\r\n", reformatted when the second changes
+struct DateCache {
+    std::time_t second = -1;
+    char line[6 + HTTP_DATE_SIZE + 3] = "Date: ";
+
+    std::string_view get() {
+        std::time_t now = std::time(nullptr);
+        if (now != second) {
+            char date[HTTP_DATE_SIZE + 1];
+            format_http_date(now, date);
+            std::memcpy(line + 6, date, HTTP_DATE_SIZE);
+            std::memcpy(line + 6 + HTTP_DATE_SIZE, "\r\n", 2);
+            second = now;
+        }
+        return std::string_view(line, 6 + HTTP_DATE_SIZE + 2);
+    }
+};
+
+thread_local DateCache date_cache;
+
+} // namespace
+
+void format_http_date(std::time_t t, char (&out)[HTTP_DATE_SIZE + 1]) {
+    std::tm tm{};
+#ifdef _WIN32
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+    std::snprintf(out, sizeof(out), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+                  DAYS[tm.tm_wday % 7], tm.tm_mday, MONTHS[tm.tm_mon % 12],
+                  (tm.tm_year + 1900) % 10000, tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+std::time_t parse_http_date(std::string_view s) {
+    // "Sun, 06 Nov 1994 08:49:37 GMT"; the obsolete formats aren't accepted
+    if (s.size() != HTTP_DATE_SIZE || s.substr(3, 2) != ", " || s.substr(25) != " GMT") return -1;
+    auto number = [&](size_t pos, size_t len, int& out) {
+        auto r = std::from_chars(s.data() + pos, s.data() + pos + len, out);
+        return r.ec == std::errc() && r.ptr == s.data() + pos + len;
+    };
+    std::tm tm{};
+    int year = 0;
+    if (!number(5, 2, tm.tm_mday) || !number(12, 4, year) || !number(17, 2, tm.tm_hour) ||
+        !number(20, 2, tm.tm_min) || !number(23, 2, tm.tm_sec)) {
+        return -1;
+    }
+    tm.tm_mon = -1;
+    for (int m = 0; m < 12; ++m) {
+        if (s.substr(8, 3) == MONTHS[m]) tm.tm_mon = m;
+    }
+    if (tm.tm_mon < 0) return -1;
+    tm.tm_year = year - 1900;
+#ifdef _WIN32
+    return _mkgmtime(&tm);
+#else
+    return timegm(&tm);
+#endif
+}
+
+ResponseHeader::ResponseHeader(std::string& out, int status) : out_(out) {
+    out_.clear();
+    if (status >= MIN_STATUS && status <= MAX_STATUS) {
+        out_ += status_lines()[status - MIN_STATUS];
+    } else {
+        out_ += "HTTP/1.1 ";
+        out_ += std::to_string(status);
+        out_ += " Error\r\n";
+    }
+    out_ += date_cache.get();
+}
+
+void ResponseHeader::add(std::string_view name, std::string_view value) {
+    out_ += name;
+    out_ += ": ";
+    out_ += value;
+    out_ += "\r\n";
+}
+
+void ResponseHeader::content_length(size_t length) {
+    char digits[24];
+    auto end = std::to_chars(digits, digits + sizeof(digits), length).ptr;
+    add("Content-Length", std::string_view(digits, end - digits));
+}
+
+void ResponseHeader::finish(bool keep_alive) {
+    out_ += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+}
+
+void ResponseHeader::finish_upgrade(std::string_view protocol) {
+    add("Upgrade", protocol);
+    out_ += "Connection: Upgrade\r\n\r\n";
+}
+
+} // namespace cppcorn::http
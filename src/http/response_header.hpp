@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <ctime>
+
+namespace cppcorn::http {
+
+const char* status_reason(int status);
+
+// IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT" (Date, Last-Modified)
+constexpr size_t HTTP_DATE_SIZE = 29;
+void format_http_date(std::time_t t, char (&out)[HTTP_DATE_SIZE + 1]);
+// Returns -1 unless `s` is an IMF-fixdate
+std::time_t parse_http_date(std::string_view s);
+
+// Appends a response's header block to a string. The status line comes from
+// a table built once, and the Date header from a per-thread cache that is
+// reformatted at most once a second, so a typical block is a few memcpys.
+class ResponseHeader {
+public:
+    // Starts the block in `out` (cleared first) with the status line and Date
+    ResponseHeader(std::string& out, int status);
+
+    void add(std::string_view name, std::string_view value);
+    void content_length(size_t length);
+    // Closes the block with the Connection header and the blank line
+    void finish(bool keep_alive);
+    // Closes a 101 block, switching to `protocol`
+    void finish_upgrade(std::string_view protocol);
+
+private:
+    std::string& out_;
+};
+
+} // namespace cppcorn::http
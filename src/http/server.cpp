@@ -1,12 +1,14 @@
 #include "server.hpp"
+#include "../core/metrics.hpp"
 #include <fmt/core.h>
 
 namespace cppcorn::http {
 
-Server::Server(std::string ip, int port) 
-    : ip_(std::move(ip)), port_(port) {}
+Server::Server(std::string ip, int port, bool reuse_port, ConnectionOptions options)
+    : ip_(std::move(ip)), port_(port), reuse_port_(reuse_port), options_(options) {}
 
 core::FireAndForget Server::run() {
+    if (reuse_port_) listen_socket_.set_reuse_port();
     listen_socket_.bind(ip_.c_str(), port_);
     listen_socket_.listen();
     listen_socket_.set_non_blocking();
@@ -14,9 +16,12 @@ core::FireAndForget Server::run() {
     fmt::print("CppCorn listening on {}:{}\n", ip_, port_);
     
     while (true) {
+        // Shedding: leave new connections in the backlog until it eases
+        if (options_.admission) co_await options_.admission->accepting();
         auto client = co_await listen_socket_.accept_async();
         if (client.fd() != INVALID_SOCKET_VAL) {
-            auto conn = new Connection(std::move(client));
+            core::Metrics::local().connections_accepted.add();
+            auto conn = new Connection(std::move(client), options_);
             conn->start(); // Fire and forget (self-deleting)
         }
     }
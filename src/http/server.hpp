@@ -9,7 +9,10 @@ namespace cppcorn::http {
 
 class Server {
 public:
-    Server(std::string ip, int port);
+    // With reuse_port, several servers (one per event loop thread) can
+    // listen on the same ip:port and the kernel shards connections.
+    // Anything `options` points to must outlive the server
+    Server(std::string ip, int port, bool reuse_port = false, ConnectionOptions options = {});
     
     // Main loop
     core::FireAndForget run();
@@ -17,6 +20,8 @@ public:
 private:
     std::string ip_;
     int port_;
+    bool reuse_port_;
+    ConnectionOptions options_;
     core::Socket listen_socket_;
 };
 
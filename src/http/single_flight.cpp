@@ -0,0 +1,65 @@
+#include "single_flight.hpp"
+#include <algorithm>
+
+namespace cppcorn::http {
+
+void Flight::finish(std::shared_ptr<const CachedResponse> shared) {
+    if (done) return;
+    done = true;
+    response = std::move(shared);
+    // Requests arriving from now on start a new flight
+    if (owner) {
+        auto it = owner->flights_.find(key);
+        if (it != owner->flights_.end() && it->second.get() == this) owner->flights_.erase(it);
+    }
+    for (auto h : std::exchange(waiters, {})) h.resume();
+}
+
+void Flight::share(const asgi::HttpResponse* start, std::string_view body) {
+    bool shareable = start && body.size() <= SingleFlight::MAX_SHARED_BYTES &&
+                     std::none_of(start->headers.begin(), start->headers.end(),
+                                  [](const auto& h) { return iequals(h.first, "set-cookie"); });
+    finish(shareable ? CachedResponse::make(*start, body) : nullptr);
+}
+
+OwnedRequest::OwnedRequest(const Request& req) : method(req.method), target(req.path) {
+    headers.reserve(req.headers.size());
+    for (const auto& [name, value] : req.headers) headers.emplace_back(name, value);
+}
+
+std::vector<std::pair<std::string_view, std::string_view>> OwnedRequest::header_views() const {
+    return {headers.begin(), headers.end()};
+}
+
+bool SingleFlight::eligible(const Request& req) {
+    if (req.method != "GET") return false;
+    for (const auto& [name, value] : req.headers) {
+        if (iequals(name, "authorization") || iequals(name, "cookie") ||
+            iequals(name, "content-length") || iequals(name, "transfer-encoding")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<Flight> SingleFlight::join(const Request& req, bool& leader) {
+    key_ = req.path;
+    for (std::string_view name : {"host", "accept", "accept-encoding", "accept-language"}) {
+        key_ += '\n';
+        key_ += req.header(name);
+    }
+
+    auto it = flights_.find(key_);
+    if (it != flights_.end()) {
+        leader = false;
+        return it->second;
+    }
+    auto flight = std::make_shared<Flight>();
+    flight->owner = this;
+    flight->key = key_;
+    flights_.emplace(key_, flight);
+    leader = true;
+    return flight;
+}
+
+} // namespace cppcorn::http
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "parser.hpp"
+#include "response_cache.hpp"
+#include <coroutine>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cppcorn::http {
+
+class SingleFlight;
+
+// One worker call shared by identical requests. The leader's exchange
+// finishes the flight with a shareable copy as soon as the worker's response
+// arrives (Bridge::Exchange::observe), however long the leader's own
+// connection takes to relay it; followers wait for it instead of sending
+// their own request.
+struct Flight {
+    SingleFlight* owner = nullptr;
+    std::string key;
+    bool done = false;
+    // Set when done, unless the response can't be shared (streamed, too
+    // large, per-client or failed); followers then ask a worker themselves
+    std::shared_ptr<const CachedResponse> response;
+    std::vector<std::coroutine_handle<>> waiters;
+
+    // Completes the flight and resumes the followers. Later calls are no-ops.
+    void finish(std::shared_ptr<const CachedResponse> shared);
+    // Completes the flight with the leader's response (null if it had none
+    // in one piece), shared if it is modest and cookie-free
+    void share(const asgi::HttpResponse* start, std::string_view body);
+
+    struct Wait {
+        Flight& flight;
+        bool await_ready() const noexcept { return flight.done; }
+        void await_suspend(std::coroutine_handle<> h) { flight.waiters.push_back(h); }
+        void await_resume() const noexcept {}
+    };
+    Wait wait() { return Wait{*this}; }
+};
+
+// A follower's own copy of its request, replayed if the flight's response
+// can't be shared
+struct OwnedRequest {
+    std::string method;
+    std::string target;
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    explicit OwnedRequest(const Request& req);
+    std::vector<std::pair<std::string_view, std::string_view>> header_views() const;
+};
+
+// Coalesces identical concurrent GETs on one loop thread (opt-in,
+// CPPCORN_COALESCE). Requests are identical if they share the target, Host
+// and content negotiation headers; anything with credentials, cookies or a
+// body is never coalesced.
+class SingleFlight {
+public:
+    static constexpr size_t MAX_SHARED_BYTES = 1 << 20;
+
+    static bool eligible(const Request& req);
+
+    // Joins the flight for `req`, starting it if there is none; `leader` is
+    // set if the caller must send the request and finish the flight.
+    std::shared_ptr<Flight> join(const Request& req, bool& leader);
+
+private:
+    friend struct Flight;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights_;
+    std::string key_; // Scratch
+};
+
+} // namespace cppcorn::http
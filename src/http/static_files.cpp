@@ -0,0 +1,278 @@
+#ifndef _WIN32
+
+#include "static_files.hpp"
+#include "response_header.hpp"
+#include "../core/event_loop.hpp"
+#include <fmt/core.h>
+#include <charconv>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cppcorn::http {
+
+StaticFile::~StaticFile() {
+    if (fd >= 0) ::close(fd);
+}
+
+static std::string_view content_type_for(std::string_view path) {
+    static const std::pair<std::string_view, std::string_view> types[] = {
+        {".html", "text/html; charset=utf-8"},
+        {".htm", "text/html; charset=utf-8"},
+        {".css", "text/css; charset=utf-8"},
+        {".js", "text/javascript; charset=utf-8"},
+        {".mjs", "text/javascript; charset=utf-8"},
+        {".json", "application/json"},
+        {".map", "application/json"},
+        {".txt", "text/plain; charset=utf-8"},
+        {".xml", "application/xml"},
+        {".svg", "image/svg+xml"},
+        {".png", "image/png"},
+        {".jpg", "image/jpeg"},
+        {".jpeg", "image/jpeg"},
+        {".gif", "image/gif"},
+        {".webp", "image/webp"},
+        {".avif", "image/avif"},
+        {".ico", "image/x-icon"},
+        {".woff", "font/woff"},
+        {".woff2", "font/woff2"},
+        {".ttf", "font/ttf"},
+        {".wasm", "application/wasm"},
+        {".pdf", "application/pdf"},
+        {".mp4", "video/mp4"},
+        {".webm", "video/webm"},
+    };
+    size_t dot = path.rfind('.');
+    if (dot != std::string_view::npos && path.find('/', dot) == std::string_view::npos) {
+        std::string_view ext = path.substr(dot);
+        for (const auto& [suffix, type] : types) {
+            if (iequals(ext, suffix)) return type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+// Appends the percent-decoded `rel` to `out`, refusing anything that could
+// leave the mount's root
+static bool append_relative(std::string_view rel, std::string& out) {
+    size_t segment = out.size();
+    for (size_t i = 0; i < rel.size(); ++i) {
+        char c = rel[i];
+        if (c == '%') {
+            int v = 0;
+            if (i + 2 >= rel.size() ||
+                std::from_chars(rel.data() + i + 1, rel.data() + i + 3, v, 16).ptr != rel.data() + i + 3) {
+                return false;
+            }
+            c = (char)v;
+            i += 2;
+        }
+        if (c == '\0' || c == '\\') return false;
+        if (c == '/') {
+            if (std::string_view(out).substr(segment) == "..") return false;
+            segment = out.size() + 1;
+        }
+        out += c;
+    }
+    return std::string_view(out).substr(segment) != "..";
+}
+
+// If-None-Match: a list of entity tags, compared weakly, or "*"
+static bool etag_matches(std::string_view header, std::string_view etag) {
+    while (!header.empty()) {
+        size_t comma = header.find(',');
+        std::string_view tag = header.substr(0, comma);
+        while (!tag.empty() && tag.front() == ' ') tag.remove_prefix(1);
+        while (!tag.empty() && tag.back() == ' ') tag.remove_suffix(1);
+        if (tag.substr(0, 2) == "W/") tag.remove_prefix(2);
+        if (tag == "*" || tag == etag) return true;
+        if (comma == std::string_view::npos) break;
+        header.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+enum class RangeResult { None, Satisfiable, Unsatisfiable };
+
+// Parses a single "bytes=first-last" / "bytes=first-" / "bytes=-suffix".
+// Multiple ranges and anything malformed are ignored (full response).
+static RangeResult parse_range(std::string_view header, uint64_t size, uint64_t& offset, uint64_t& length) {
+    if (header.substr(0, 6) != "bytes=") return RangeResult::None;
+    std::string_view spec = header.substr(6);
+    if (spec.find(',') != std::string_view::npos) return RangeResult::None;
+    size_t dash = spec.find('-');
+    if (dash == std::string_view::npos) return RangeResult::None;
+
+    auto number = [](std::string_view s, uint64_t& out) {
+        auto r = std::from_chars(s.data(), s.data() + s.size(), out);
+        return !s.empty() && r.ec == std::errc() && r.ptr == s.data() + s.size();
+    };
+    std::string_view first_s = spec.substr(0, dash), last_s = spec.substr(dash + 1);
+    uint64_t first = 0, last = 0;
+    if (first_s.empty()) {
+        // Suffix: the final `last` bytes
+        if (!number(last_s, last)) return RangeResult::None;
+        if (last == 0 || size == 0) return RangeResult::Unsatisfiable;
+        offset = size - std::min(last, size);
+        length = size - offset;
+        return RangeResult::Satisfiable;
+    }
+    if (!number(first_s, first)) return RangeResult::None;
+    if (last_s.empty()) {
+        last = size ? size - 1 : 0;
+    } else if (!number(last_s, last) || last < first) {
+        return RangeResult::None;
+    }
+    if (first >= size) return RangeResult::Unsatisfiable;
+    offset = first;
+    length = std::min(last, size - 1) - first + 1;
+    return RangeResult::Satisfiable;
+}
+
+static void error_response(StaticResponse& out, int status, std::string_view extra_name = {},
+                           std::string_view extra_value = {}) {
+    std::string_view body = status_reason(status);
+    out.status = status;
+    ResponseHeader head(out.header, status);
+    if (!extra_name.empty()) head.add(extra_name, extra_value);
+    head.add("Content-Type", "text/plain");
+    head.content_length(body.size());
+    head.finish(true);
+    out.header += body;
+}
+
+StaticFiles::StaticFiles(std::vector<StaticMount> mounts) : mounts_(std::move(mounts)) {
+    for (auto& m : mounts_) {
+        // "/static" serves "/static/..." but not "/staticfoo"
+        if (m.prefix.empty() || m.prefix.back() != '/') m.prefix += '/';
+        while (m.root.size() > 1 && m.root.back() == '/') m.root.pop_back();
+    }
+}
+
+bool StaticFiles::respond(const Request& req, StaticResponse& out) {
+    std::string_view target = req.path.substr(0, req.path.find_first_of("?#"));
+    const StaticMount* mount = nullptr;
+    for (const auto& m : mounts_) {
+        if (target.substr(0, m.prefix.size()) == m.prefix) {
+            mount = &m;
+            break;
+        }
+    }
+    if (!mount) return false;
+
+    out.file.reset();
+    out.offset = out.length = 0;
+
+    bool head_only = req.method == "HEAD";
+    if (req.method != "GET" && !head_only) {
+        error_response(out, 405, "Allow", "GET, HEAD");
+        return true;
+    }
+
+    path_ = mount->root;
+    path_ += '/';
+    if (!append_relative(target.substr(mount->prefix.size()), path_)) {
+        error_response(out, 404);
+        return true;
+    }
+    if (path_.back() == '/') path_ += "index.html";
+
+    auto file = open(path_);
+    if (!file) {
+        error_response(out, 404);
+        return true;
+    }
+
+    // Revalidation (RFC 9110 13.2.2): If-None-Match wins over If-Modified-Since
+    bool not_modified = false;
+    if (std::string_view inm = req.header("If-None-Match"); !inm.empty()) {
+        not_modified = etag_matches(inm, file->etag);
+    } else if (std::string_view ims = req.header("If-Modified-Since"); !ims.empty()) {
+        std::time_t since = parse_http_date(ims);
+        not_modified = since >= 0 && file->mtime_ns / 1000000000 <= since;
+    }
+    if (not_modified) {
+        out.status = 304;
+        ResponseHeader head(out.header, 304);
+        head.add("ETag", file->etag);
+        head.add("Last-Modified", file->last_modified);
+        head.finish(true);
+        return true;
+    }
+
+    uint64_t offset = 0, length = file->size;
+    RangeResult range = RangeResult::None;
+    if (std::string_view r = req.header("Range"); !r.empty() && !head_only) {
+        // If-Range: only honour the range if the client's copy is current
+        std::string_view if_range = req.header("If-Range");
+        bool current = if_range.empty() || if_range == file->etag || if_range == file->last_modified;
+        if (current) range = parse_range(r, file->size, offset, length);
+    }
+    if (range == RangeResult::Unsatisfiable) {
+        error_response(out, 416, "Content-Range", fmt::format("bytes */{}", file->size));
+        return true;
+    }
+
+    out.status = range == RangeResult::Satisfiable ? 206 : 200;
+    ResponseHeader head(out.header, out.status);
+    head.add("Content-Type", file->content_type);
+    head.add("ETag", file->etag);
+    head.add("Last-Modified", file->last_modified);
+    head.add("Accept-Ranges", "bytes");
+    if (range == RangeResult::Satisfiable) {
+        head.add("Content-Range", fmt::format("bytes {}-{}/{}", offset, offset + length - 1, file->size));
+    }
+    head.content_length(length);
+    head.finish(true);
+
+    if (!head_only && length > 0) {
+        out.file = std::move(file);
+        out.offset = offset;
+        out.length = length;
+    }
+    return true;
+}
+
+std::shared_ptr<const StaticFile> StaticFiles::open(const std::string& path) {
+    uint64_t now = core::EventLoop::monotonic_ms();
+    struct stat st;
+
+    auto it = cache_.find(path);
+    if (it != cache_.end()) {
+        StaticFile& f = *it->second;
+        if (now - f.checked_ms < REVALIDATE_MS) return it->second;
+        if (::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && (uint64_t)st.st_ino == f.inode &&
+            (uint64_t)st.st_size == f.size &&
+            st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec == f.mtime_ns) {
+            f.checked_ms = now;
+            return it->second;
+        }
+        cache_.erase(it); // Changed or gone
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    auto file = std::make_shared<StaticFile>();
+    file->fd = fd;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return nullptr; // Directories included
+
+    file->size = (uint64_t)st.st_size;
+    file->inode = (uint64_t)st.st_ino;
+    file->mtime_ns = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    file->etag = fmt::format("\"{:x}-{:x}\"", file->mtime_ns, file->size);
+    char date[HTTP_DATE_SIZE + 1];
+    format_http_date(st.st_mtim.tv_sec, date);
+    file->last_modified = date;
+    file->content_type = content_type_for(path);
+    file->checked_ms = now;
+
+    // Past the limit an arbitrary entry makes room; a response still
+    // sending it keeps its fd open until done
+    if (cache_.size() >= MAX_OPEN) cache_.erase(cache_.begin());
+    cache_.emplace(path, file);
+    return file;
+}
+
+} // namespace cppcorn::http
+
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "parser.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cppcorn::http {
+
+// URL prefix served from a directory, e.g. {"/static/", "./public"}
+struct StaticMount {
+    std::string prefix;
+    std::string root;
+};
+
+// An open file and its validators. Responses in flight hold a reference, so
+// the fd stays open even if the cache drops the entry meanwhile.
+struct StaticFile {
+    int fd = -1;
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    uint64_t inode = 0;
+    std::string etag;          // Quoted
+    std::string last_modified; // IMF-fixdate
+    std::string_view content_type;
+    uint64_t checked_ms = 0;   // Last stat (EventLoop::monotonic_ms)
+
+    StaticFile() = default;
+    StaticFile(const StaticFile&) = delete;
+    StaticFile& operator=(const StaticFile&) = delete;
+    ~StaticFile();
+};
+
+// A response made without the app: the header block (with any short error
+// body), then `length` bytes of `file` from `offset` if `file` is set.
+struct StaticResponse {
+    int status = 200;
+    std::string header;
+    std::shared_ptr<const StaticFile> file;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+};
+
+// Serves files under the configured mounts. One per event loop thread, so
+// the cache of open fds and stat results needs no locking; entries are
+// re-stat'ed at most once a second and reopened if the file changed.
+// Handles GET/HEAD, ETag/Last-Modified revalidation (304) and single
+// byte ranges (206/416). POSIX-only: on Windows nothing is mounted.
+class StaticFiles {
+public:
+    static constexpr size_t MAX_OPEN = 1024;
+    static constexpr uint64_t REVALIDATE_MS = 1000;
+
+    explicit StaticFiles(std::vector<StaticMount> mounts);
+
+    // Returns false if `req` isn't under a mount (it goes to the app);
+    // otherwise `out` is the complete response, 404 included.
+    bool respond(const Request& req, StaticResponse& out);
+
+private:
+    std::shared_ptr<const StaticFile> open(const std::string& path);
+
+    std::vector<StaticMount> mounts_;
+    std::unordered_map<std::string, std::shared_ptr<StaticFile>> cache_;
+    std::string path_; // Scratch for the resolved path
+};
+
+} // namespace cppcorn::http
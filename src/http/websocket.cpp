@@ -0,0 +1,462 @@
+#include "websocket.hpp"
+#include "../core/timeout.hpp"
+#include <fmt/core.h>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace cppcorn::http {
+
+namespace {
+
+// SHA-1, only for the handshake's accept key
+std::array<uint8_t, 20> sha1(std::string_view data) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    auto rotl = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+
+    std::string msg(data);
+    uint64_t bits = (uint64_t)data.size() * 8;
+    msg += (char)0x80;
+    while (msg.size() % 64 != 56) msg += (char)0;
+    for (int i = 7; i >= 0; --i) msg += (char)(bits >> (i * 8));
+
+    for (size_t chunk = 0; chunk < msg.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const auto* p = (const uint8_t*)msg.data() + chunk + i * 4;
+            w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+        }
+        for (int i = 16; i < 80; ++i) w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t t = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    std::array<uint8_t, 20> out;
+    for (int i = 0; i < 20; ++i) out[i] = (uint8_t)(h[i / 4] >> (24 - (i % 4) * 8));
+    return out;
+}
+
+std::string base64(const uint8_t* data, size_t size) {
+    static constexpr char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t n = (uint32_t)data[i] << 16;
+        if (i + 1 < size) n |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < size) n |= data[i + 2];
+        out += table[(n >> 18) & 63];
+        out += table[(n >> 12) & 63];
+        out += i + 1 < size ? table[(n >> 6) & 63] : '=';
+        out += i + 2 < size ? table[n & 63] : '=';
+    }
+    return out;
+}
+
+// Whether the comma-separated `list` contains `token` (any case)
+bool has_token(std::string_view list, std::string_view token) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (iequals(item, token)) return true;
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// Close codes a client may send (RFC 6455 section 7.4)
+bool valid_close_code(uint16_t code) {
+    if (code >= 3000 && code <= 4999) return true;
+    return code >= 1000 && code <= 1014 && code != 1004 && code != 1005 && code != 1006;
+}
+
+uint64_t load_be(const char* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v = v << 8 | (uint8_t)p[i];
+    return v;
+}
+
+} // namespace
+
+bool is_websocket_upgrade(const Request& req) {
+    return iequals(req.header("upgrade"), "websocket") &&
+           has_token(req.header("connection"), "upgrade");
+}
+
+int websocket_handshake_error(const Request& req) {
+    if (req.method != "GET" || req.header("sec-websocket-key").empty()) return 400;
+    if (req.header("sec-websocket-version") != "13") return 426;
+    return 0;
+}
+
+std::string websocket_accept(std::string_view key) {
+    std::string input(key);
+    input += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    auto digest = sha1(input);
+    return base64(digest.data(), digest.size());
+}
+
+void websocket_unmask(char* data, size_t size, uint32_t mask, size_t phase) {
+    // Rotate the key so that it starts at data[0]
+    uint8_t key[4];
+    std::memcpy(key, &mask, 4);
+    uint8_t k[4] = {key[phase & 3], key[(phase + 1) & 3], key[(phase + 2) & 3], key[(phase + 3) & 3]};
+    uint32_t k32;
+    std::memcpy(&k32, k, 4);
+
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i m256 = _mm256_set1_epi32((int)k32);
+    for (; i + 32 <= size; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        _mm256_storeu_si256((__m256i*)(data + i), _mm256_xor_si256(v, m256));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i m128 = _mm_set1_epi32((int)k32);
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        _mm_storeu_si128((__m128i*)(data + i), _mm_xor_si128(v, m128));
+    }
+#elif defined(__ARM_NEON)
+    uint8x16_t m128 = vreinterpretq_u8_u32(vdupq_n_u32(k32));
+    for (; i + 16 <= size; i += 16) {
+        uint8_t* p = (uint8_t*)data + i;
+        vst1q_u8(p, veorq_u8(vld1q_u8(p), m128));
+    }
+#endif
+    uint64_t m64 = (uint64_t)k32 << 32 | k32;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t v;
+        std::memcpy(&v, data + i, 8);
+        v ^= m64;
+        std::memcpy(data + i, &v, 8);
+    }
+    for (; i < size; ++i) data[i] ^= (char)k[i & 3];
+}
+
+void websocket_frame_header(std::string& out, WsOpcode opcode, size_t size) {
+    out += (char)(0x80 | (uint8_t)opcode);
+    if (size < 126) {
+        out += (char)size;
+    } else if (size <= 0xFFFF) {
+        out += (char)126;
+        out += (char)(size >> 8);
+        out += (char)size;
+    } else {
+        out += (char)127;
+        for (int i = 7; i >= 0; --i) out += (char)((uint64_t)size >> (i * 8));
+    }
+}
+
+bool valid_utf8(std::string_view s) {
+    const auto* p = (const unsigned char*)s.data();
+    const auto* end = p + s.size();
+    while (p < end) {
+        // ASCII runs go 8 bytes at a time
+        if (end - p >= 8) {
+            uint64_t w;
+            std::memcpy(&w, p, 8);
+            if (!(w & 0x8080808080808080ull)) {
+                p += 8;
+                continue;
+            }
+        }
+        unsigned char c = *p;
+        if (c < 0x80) {
+            ++p;
+            continue;
+        }
+        size_t n;
+        uint32_t cp;
+        if ((c & 0xE0) == 0xC0) { n = 1; cp = c & 0x1F; }
+        else if ((c & 0xF0) == 0xE0) { n = 2; cp = c & 0x0F; }
+        else if ((c & 0xF8) == 0xF0) { n = 3; cp = c & 0x07; }
+        else return false;
+        if (end - p <= (ptrdiff_t)n) return false;
+        for (size_t i = 1; i <= n; ++i) {
+            if ((p[i] & 0xC0) != 0x80) return false;
+            cp = cp << 6 | (p[i] & 0x3F);
+        }
+        // No overlong forms, surrogates or values past U+10FFFF
+        static constexpr uint32_t smallest[] = {0, 0x80, 0x800, 0x10000};
+        if (cp < smallest[n] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return false;
+        p += n + 1;
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// WebSocketParser
+// ----------------------------------------------------------------------------
+
+bool WebSocketParser::feed(std::string_view& data, Frame& out) {
+    while (true) {
+        if (!in_payload_) {
+            while (header_size_ < header_need_) {
+                if (data.empty()) return false;
+                size_t n = std::min(header_need_ - header_size_, data.size());
+                std::memcpy(header_ + header_size_, data.data(), n);
+                header_size_ += n;
+                data.remove_prefix(n);
+                if (header_size_ == 2) {
+                    if (!(header_[1] & 0x80)) throw WebSocketError(WS_PROTOCOL_ERROR, "Unmasked client frame");
+                    uint8_t len = header_[1] & 0x7F;
+                    header_need_ = 2 + (len == 126 ? 2 : len == 127 ? 8 : 0) + 4;
+                }
+            }
+            start_frame();
+        }
+
+        bool control = (uint8_t)opcode_ & 0x8;
+        std::string& payload = control ? control_ : message_;
+        size_t n = (size_t)std::min<uint64_t>(left_, data.size());
+        size_t at = payload.size();
+        payload.append(data.data(), n);
+        websocket_unmask(payload.data() + at, n, mask_, phase_);
+        phase_ = (phase_ + n) & 3;
+        left_ -= n;
+        data.remove_prefix(n);
+        if (left_ > 0) return false;
+
+        in_payload_ = false;
+        header_size_ = 0;
+        header_need_ = 2;
+        if (control) {
+            out = {opcode_, control_};
+            return true;
+        }
+        if (!fin_) continue;
+        in_message_ = false;
+        if (message_opcode_ == WsOpcode::Text && !valid_utf8(message_)) {
+            throw WebSocketError(WS_INVALID_DATA, "Text message is not UTF-8");
+        }
+        out = {message_opcode_, message_};
+        return true;
+    }
+}
+
+void WebSocketParser::start_frame() {
+    uint8_t b0 = (uint8_t)header_[0];
+    if (b0 & 0x70) throw WebSocketError(WS_PROTOCOL_ERROR, "Reserved bits set");
+    fin_ = b0 & 0x80;
+    opcode_ = (WsOpcode)(b0 & 0x0F);
+
+    uint64_t len = header_[1] & 0x7F;
+    size_t pos = 2;
+    if (len == 126) {
+        len = load_be(header_ + 2, 2);
+        pos = 4;
+    } else if (len == 127) {
+        len = load_be(header_ + 2, 8);
+        pos = 10;
+    }
+    std::memcpy(&mask_, header_ + pos, 4);
+
+    switch (opcode_) {
+    case WsOpcode::Continuation:
+        if (!in_message_) throw WebSocketError(WS_PROTOCOL_ERROR, "Continuation outside a message");
+        break;
+    case WsOpcode::Text:
+    case WsOpcode::Binary:
+        if (in_message_) throw WebSocketError(WS_PROTOCOL_ERROR, "Message inside a fragmented message");
+        in_message_ = true;
+        message_opcode_ = opcode_;
+        message_.clear();
+        break;
+    case WsOpcode::Close:
+    case WsOpcode::Ping:
+    case WsOpcode::Pong:
+        if (!fin_ || len > 125) throw WebSocketError(WS_PROTOCOL_ERROR, "Bad control frame");
+        control_.clear();
+        break;
+    default:
+        throw WebSocketError(WS_PROTOCOL_ERROR, "Unknown opcode");
+    }
+    if (!((uint8_t)opcode_ & 0x8) && len > WS_MAX_MESSAGE - message_.size()) {
+        throw WebSocketError(WS_TOO_BIG, "Message too big");
+    }
+    left_ = len;
+    phase_ = 0;
+    in_payload_ = true;
+}
+
+// ----------------------------------------------------------------------------
+// WebSocketSession
+// ----------------------------------------------------------------------------
+
+WebSocketSession::WebSocketSession(core::Socket& socket, asgi::Bridge::Exchange& exchange,
+                                   std::chrono::milliseconds ping_interval)
+    : socket_(socket), exchange_(exchange), ping_interval_(ping_interval),
+      metrics_(core::Metrics::local()) {}
+
+core::Task<void> WebSocketSession::run(std::string input) {
+    read_loop(std::move(input));
+
+    while (true) {
+        if (!control_out_.empty()) {
+            std::string frames = std::move(control_out_);
+            control_out_.clear();
+            if (!co_await write(frames)) break;
+            continue;
+        }
+        if (close_sent_ || client_closed_) break;
+
+        asgi::WebSocketMessage msg;
+        std::optional<bool> got;
+        bool failed = false;
+        try {
+            if (ping_interval_.count() > 0) {
+                got = co_await core::with_timeout(exchange_.receive_message(msg), ping_interval_,
+                                                  [this] { exchange_.interrupt(); });
+            } else {
+                got = co_await exchange_.receive_message(msg);
+            }
+        } catch (const std::exception& e) {
+            fmt::print("Worker Error: {}\n", e.what());
+            failed = true;
+        }
+        if (failed) {
+            metrics_.error(core::ErrorKind::Worker);
+            close(WS_INTERNAL_ERROR);
+        } else if (!got) {
+            // Idle: ping, unless the last ping went unanswered
+            if (!heard_) {
+                client_closed_ = true;
+                socket_.shutdown();
+                break;
+            }
+            heard_ = false;
+            websocket_frame_header(control_out_, WsOpcode::Ping, 0);
+        } else if (*got) {
+            std::string header;
+            websocket_frame_header(header, msg.text ? WsOpcode::Text : WsOpcode::Binary, msg.data.size());
+            if (!co_await write(header, msg.data)) break;
+        } else if (exchange_.closed_by_app()) {
+            close(exchange_.close_code(), exchange_.close_reason());
+        }
+        // Otherwise the reader interrupted us: see what it queued
+    }
+
+    // Give the client a moment to answer our close frame, then hang up
+    if (!reader_done_) {
+        co_await core::with_timeout(ReaderDone{*this}, WS_CLOSE_TIMEOUT, [this] {
+            exchange_.send_close(WS_ABNORMAL); // In case the reader waits on the app
+            socket_.shutdown();
+        });
+    }
+    while (!reader_done_) co_await ReaderDone{*this};
+}
+
+core::FireAndForget WebSocketSession::read_loop(std::string input) {
+    std::vector<char> buffer(16 * 1024);
+    std::string_view data = input;
+    WebSocketParser parser;
+    WebSocketParser::Frame frame;
+    uint16_t code = WS_ABNORMAL; // What the app is told
+    try {
+        while (!client_closed_) {
+            if (!parser.feed(data, frame)) {
+                size_t n = co_await socket_.read(std::span(buffer));
+                if (n == 0) break;
+                metrics_.bytes_in.add(n);
+                heard_ = true;
+                data = std::string_view(buffer.data(), n);
+                continue;
+            }
+
+            switch (frame.opcode) {
+            case WsOpcode::Text:
+            case WsOpcode::Binary:
+                // Waits while the app is behind, which stops our reads. Once
+                // the app has closed, messages are dropped.
+                co_await exchange_.send_message(frame.payload, frame.opcode == WsOpcode::Text);
+                break;
+            case WsOpcode::Ping:
+                if (!close_sent_) {
+                    websocket_frame_header(control_out_, WsOpcode::Pong, frame.payload.size());
+                    control_out_ += frame.payload;
+                    exchange_.interrupt();
+                }
+                break;
+            case WsOpcode::Pong:
+                break;
+            default: { // Close
+                std::string_view payload = frame.payload;
+                code = WS_NO_STATUS;
+                if (payload.size() == 1) throw WebSocketError(WS_PROTOCOL_ERROR, "Bad close frame");
+                if (payload.size() >= 2) {
+                    code = (uint16_t)load_be(payload.data(), 2);
+                    if (!valid_close_code(code)) throw WebSocketError(WS_PROTOCOL_ERROR, "Bad close code");
+                    if (!valid_utf8(payload.substr(2))) throw WebSocketError(WS_INVALID_DATA, "Bad close reason");
+                }
+                // Echo the code back, as RFC 6455 asks
+                if (!close_sent_) {
+                    if (code == WS_NO_STATUS) {
+                        websocket_frame_header(control_out_, WsOpcode::Close, 0);
+                        close_sent_ = true;
+                    } else {
+                        close(code);
+                    }
+                }
+                client_closed_ = true;
+                break;
+            }
+            }
+        }
+    } catch (const WebSocketError& e) {
+        fmt::print("WebSocket Error: {}\n", e.what());
+        metrics_.error(core::ErrorKind::Parse);
+        code = e.code;
+        if (!close_sent_) close(e.code);
+    } catch (const std::exception& e) {
+        fmt::print("Connection Error: {}\n", e.what());
+        metrics_.error(core::ErrorKind::Connection);
+    }
+
+    client_closed_ = true;
+    exchange_.send_close(code); // websocket.disconnect, unless the app closed first
+    exchange_.interrupt();
+    reader_done_ = true;
+    // Last: the writer may finish, and its connection go, once resumed
+    if (auto h = std::exchange(reader_waiter_, nullptr)) h.resume();
+}
+
+void WebSocketSession::close(uint16_t code, std::string_view reason) {
+    reason = reason.substr(0, 123); // A control frame carries at most 125 bytes
+    websocket_frame_header(control_out_, WsOpcode::Close, 2 + reason.size());
+    control_out_ += (char)(code >> 8);
+    control_out_ += (char)code;
+    control_out_ += reason;
+    close_sent_ = true;
+}
+
+core::Task<bool> WebSocketSession::write(std::string_view header, std::string_view payload) {
+    std::array slices{core::Socket::slice(header), core::Socket::slice(payload)};
+    size_t n = co_await socket_.write_vectored(std::span(slices.data(), payload.empty() ? 1 : 2));
+    metrics_.bytes_out.add(n);
+    co_return n == header.size() + payload.size();
+}
+
+} // namespace cppcorn::http
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "parser.hpp"
+#include "../asgi/bridge.hpp"
+#include "../core/socket.hpp"
+#include "../core/coroutine.hpp"
+#include "../core/metrics.hpp"
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace cppcorn::http {
+
+// RFC 6455 opcodes
+enum class WsOpcode : uint8_t {
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA
+};
+
+// Close codes we use ourselves
+constexpr uint16_t WS_NORMAL = 1000;
+constexpr uint16_t WS_PROTOCOL_ERROR = 1002;
+constexpr uint16_t WS_NO_STATUS = 1005;    // The client's close frame had no code
+constexpr uint16_t WS_ABNORMAL = 1006;     // The client left without a close frame
+constexpr uint16_t WS_INVALID_DATA = 1007;
+constexpr uint16_t WS_TOO_BIG = 1009;
+constexpr uint16_t WS_INTERNAL_ERROR = 1011;
+
+// Largest message taken from a client, fragments included
+constexpr size_t WS_MAX_MESSAGE = 16 * 1024 * 1024;
+// How long we wait for the client's close frame after sending ours
+constexpr std::chrono::milliseconds WS_CLOSE_TIMEOUT{5000};
+
+// A protocol violation by the client; `code` goes in our close frame
+struct WebSocketError : std::runtime_error {
+    uint16_t code;
+    WebSocketError(uint16_t c, const char* what) : std::runtime_error(what), code(c) {}
+};
+
+// True if `req` asks to switch to the websocket protocol
+bool is_websocket_upgrade(const Request& req);
+// 0 if the upgrade request is valid (RFC 6455 section 4.2.1), otherwise the
+// status to refuse it with: 426 for a version other than 13, else 400
+int websocket_handshake_error(const Request& req);
+// Sec-WebSocket-Accept for the client's Sec-WebSocket-Key
+std::string websocket_accept(std::string_view key);
+
+// XORs `data` with a frame's masking key, starting `phase` bytes into the
+// key. Vectorised: 32 bytes a step with AVX2 (when the build targets it),
+// 16 with SSE2 or NEON, otherwise 8.
+void websocket_unmask(char* data, size_t size, uint32_t mask, size_t phase);
+// Appends the header of an unmasked (server) frame with FIN set
+void websocket_frame_header(std::string& out, WsOpcode opcode, size_t size);
+bool valid_utf8(std::string_view s);
+
+// Incremental parser for frames from a client. Fragmented messages are
+// reassembled, and control frames in between them come out on their own.
+// Payloads are unmasked as they are copied out of the read buffer, so each
+// byte is copied once.
+class WebSocketParser {
+public:
+    struct Frame {
+        WsOpcode opcode;          // Text or Binary for a whole message
+        std::string_view payload; // Valid until the next frame of its kind starts
+    };
+
+    // Consumes `data` from the front until a frame completes (returns true
+    // with `out` set) or `data` runs out (returns false). Throws
+    // WebSocketError on a protocol violation.
+    bool feed(std::string_view& data, Frame& out);
+
+private:
+    void start_frame();
+
+    char header_[14];        // Longest header: 2 + 8 length + 4 mask
+    size_t header_size_ = 0; // Bytes of it received
+    size_t header_need_ = 2; // Known once the first two are in
+    bool in_payload_ = false;
+    WsOpcode opcode_ = WsOpcode::Continuation;
+    bool fin_ = false;
+    uint64_t left_ = 0;      // Payload bytes still to come
+    uint32_t mask_ = 0;
+    size_t phase_ = 0;       // Position in the mask of the next byte
+    bool in_message_ = false;
+    WsOpcode message_opcode_ = WsOpcode::Text;
+    std::string message_;
+    std::string control_;
+};
+
+// A websocket after its handshake. The client's messages go to the app
+// through `exchange` and the app's come back as frames. Pings, pongs,
+// keepalive and the close handshake are handled here, so an idle socket
+// costs the app nothing; it sees messages and a final disconnect.
+//
+// A reader coroutine owns the socket's reads and run() its writes. The
+// reader queues control frames and interrupts the writer's wait on the app.
+class WebSocketSession {
+public:
+    // A keepalive ping goes out after `ping_interval` with nothing from the
+    // app, and the connection is dropped if the client has sent nothing by
+    // the next one (0 turns keepalive off).
+    WebSocketSession(core::Socket& socket, asgi::Bridge::Exchange& exchange,
+                     std::chrono::milliseconds ping_interval);
+
+    // Runs until the socket closes. `input` is what the client sent after
+    // its handshake request.
+    core::Task<void> run(std::string input);
+
+private:
+    struct ReaderDone {
+        WebSocketSession& s;
+        bool await_ready() const noexcept { return s.reader_done_; }
+        void await_suspend(std::coroutine_handle<> h) { s.reader_waiter_ = h; }
+        void await_resume() const noexcept {}
+    };
+
+    core::FireAndForget read_loop(std::string input);
+    // Queues a close frame; nothing else is sent after it
+    void close(uint16_t code, std::string_view reason = {});
+    core::Task<bool> write(std::string_view header, std::string_view payload = {});
+
+    core::Socket& socket_;
+    asgi::Bridge::Exchange& exchange_;
+    std::chrono::milliseconds ping_interval_;
+    core::Metrics& metrics_;
+    std::string control_out_;     // Control frames waiting for the writer
+    bool heard_ = true;           // Something came from the client since the last ping
+    bool close_sent_ = false;
+    bool client_closed_ = false;  // Close frame received, or the client is gone
+    bool reader_done_ = false;
+    std::coroutine_handle<> reader_waiter_;
+};
+
+} // namespace cppcorn::http
@@ -8,40 +8,251 @@ using namespace cppcorn::core;
 using namespace cppcorn::http;
 using namespace cppcorn::asgi;
 
-// Global bridge definition
+// Per-thread bridge definition (each event loop thread owns its own worker pool)
 namespace cppcorn::http {
-    cppcorn::asgi::Bridge* g_bridge = nullptr;
+    thread_local cppcorn::asgi::Bridge* g_bridge = nullptr;
 }
 
 #include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <chrono>
+#include <string_view>
+#include <algorithm>
+
+// Number of event loop threads. Each one owns an EventLoop, a Server bound
+// with SO_REUSEPORT and a Bridge with its own workers.
+static int loop_thread_count() {
+    const char* env = std::getenv("CPPCORN_THREADS");
+    if (!env) return 1;
+    int n = std::atoi(env);
+    if (n == 0) n = (int)std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+// Connection timeouts in (fractional) seconds, e.g. CPPCORN_KEEPALIVE_TIMEOUT=5
+static void read_timeout_env(const char* name, std::chrono::milliseconds& out) {
+    if (const char* env = std::getenv(name)) {
+        out = std::chrono::milliseconds((long long)(std::atof(env) * 1000));
+    }
+}
+
+static ConnectionTimeouts connection_timeouts() {
+    ConnectionTimeouts t;
+    read_timeout_env("CPPCORN_KEEPALIVE_TIMEOUT", t.keep_alive);
+    read_timeout_env("CPPCORN_HEADER_TIMEOUT", t.header_read);
+    read_timeout_env("CPPCORN_BODY_TIMEOUT", t.body_read);
+    read_timeout_env("CPPCORN_WS_PING_INTERVAL", t.websocket_ping);
+    return t;
+}
+
+// CPPCORN_WORKERS: total Python workers, shared out across the loop threads
+// (at least one each). CPPCORN_PYTHON / CPPCORN_WORKER_SCRIPT override how
+// they are launched, CPPCORN_IPC (tcp, unix or shm on x86-64) how they connect.
+static int worker_count(int threads) {
+    const char* env = std::getenv("CPPCORN_WORKERS");
+    int n = env ? std::atoi(env) : threads;
+    return n > threads ? n : threads;
+}
+
+#ifndef _WIN32
+// CPPCORN_EMBED=1 runs the app on interpreter threads in this process
+// (CPPCORN_WORKERS of them) instead of worker processes; CPPCORN_WORKER_SCRIPT
+// then names the glue module. Needs a -DCPPCORN_EMBED_PYTHON=ON build.
+// CPPCORN_SUBINTERPRETERS=1 gives each thread a subinterpreter with its own
+// GIL on 3.12+. It is off by default because many extension modules
+// (pydantic_core, for one) refuse to load in a subinterpreter.
+static bool embedded_python() {
+    const char* env = std::getenv("CPPCORN_EMBED");
+    return env && std::atoi(env) > 0;
+}
+#endif
+
+static WorkerConfig worker_config(int index, int threads, int workers) {
+    WorkerConfig config;
+    config.count = workers / threads + (index < workers % threads ? 1 : 0);
+#ifndef _WIN32
+    if (embedded_python()) {
+        config.embedded = true;
+        config.script = "python/embedded.py";
+    }
+#endif
+    if (const char* env = std::getenv("CPPCORN_PYTHON")) config.python = env;
+    if (const char* env = std::getenv("CPPCORN_WORKER_SCRIPT")) config.script = env;
+    if (const char* env = std::getenv("CPPCORN_IPC")) {
+        if (std::strcmp(env, "tcp") == 0) config.transport = IpcTransport::Tcp;
+#ifndef _WIN32
+        else if (std::strcmp(env, "unix") == 0) config.transport = IpcTransport::Unix;
+#if defined(__x86_64__)
+        // The worker's side of the rings (python/worker.py) relies on
+        // x86-64 keeping plain loads and stores in order
+        else if (std::strcmp(env, "shm") == 0) config.transport = IpcTransport::Shm;
+#else
+        else if (std::strcmp(env, "shm") == 0) fmt::print("CPPCORN_IPC=shm needs x86-64, using unix\n");
+#endif
+#endif
+        else fmt::print("Unknown CPPCORN_IPC '{}', using the default\n", env);
+    }
+    return config;
+}
+
+// CPPCORN_CACHE_MB: memory for cached app responses, shared by all loop
+// threads (default 0, off). Only responses the app marks cacheable are kept.
+static std::unique_ptr<ResponseCache> response_cache() {
+    const char* env = std::getenv("CPPCORN_CACHE_MB");
+    double mb = env ? std::atof(env) : 0;
+    if (mb <= 0) return nullptr;
+    fmt::print("Response cache: {} MB\n", mb);
+    return std::make_unique<ResponseCache>((size_t)(mb * 1024 * 1024));
+}
+
+// CPPCORN_ADMISSION=0 turns the adaptive limit on worker calls off.
+// CPPCORN_MAX_CONCURRENCY caps it per loop thread, CPPCORN_MAX_QUEUE bounds
+// the requests waiting for a slot and CPPCORN_QUEUE_TIMEOUT (seconds) how
+// long they wait; the rest get a 503.
+static std::unique_ptr<Admission> admission(const WorkerConfig& workers) {
+    if (const char* env = std::getenv("CPPCORN_ADMISSION"); env && std::atoi(env) <= 0) return nullptr;
+    AdmissionConfig config;
+    config.min_limit = (size_t)workers.count;
+    config.initial_limit = (size_t)workers.count * 16;
+    if (const char* env = std::getenv("CPPCORN_MAX_CONCURRENCY")) config.max_limit = std::atoi(env);
+    if (const char* env = std::getenv("CPPCORN_MAX_QUEUE")) config.max_queue = std::atoi(env);
+    if (const char* env = std::getenv("CPPCORN_QUEUE_TIMEOUT")) {
+        config.max_wait_ms = (uint64_t)(std::atof(env) * 1000);
+    }
+    return std::make_unique<Admission>(config);
+}
+
+// CPPCORN_ACCESS_LOG=path (or - for stdout): JSON lines with each request's
+// status, bytes and timings, written by a background thread. Set
+// CPPCORN_ACCESS_LOG_SAMPLE (0 to 1) to log only a fraction of requests.
+static std::unique_ptr<AccessLog> access_log() {
+    const char* env = std::getenv("CPPCORN_ACCESS_LOG");
+    if (!env || !*env) return nullptr;
+    double rate = 1;
+    if (const char* sample = std::getenv("CPPCORN_ACCESS_LOG_SAMPLE")) rate = std::atof(sample);
+    fmt::print("Access log: {} (sampling {})\n", env, rate);
+    return std::make_unique<AccessLog>(env, rate);
+}
+
+#ifndef _WIN32
+// CPPCORN_STATIC=/static=./public[,/assets=/srv/assets]: URL prefixes served
+// straight from disk, never reaching the workers
+static std::vector<StaticMount> static_mounts() {
+    std::vector<StaticMount> mounts;
+    const char* env = std::getenv("CPPCORN_STATIC");
+    if (!env) return mounts;
+    std::string_view spec = env;
+    while (!spec.empty()) {
+        std::string_view item = spec.substr(0, spec.find(','));
+        spec.remove_prefix(std::min(spec.size(), item.size() + 1));
+        size_t eq = item.find('=');
+        if (eq == std::string_view::npos || eq == 0) {
+            fmt::print("Ignoring CPPCORN_STATIC entry '{}' (want /prefix=dir)\n", item);
+            continue;
+        }
+        mounts.push_back({std::string(item.substr(0, eq)), std::string(item.substr(eq + 1))});
+        fmt::print("Serving {} from {}\n", mounts.back().prefix, mounts.back().root);
+    }
+    return mounts;
+}
+
+// CPPCORN_IO_BACKEND=io_uring selects the completion backend (default: epoll)
+static void select_io_backend() {
+    const char* env = std::getenv("CPPCORN_IO_BACKEND");
+    if (env && std::strcmp(env, "io_uring") == 0) {
+        EventLoop::set_default_backend(IoBackend::IoUring);
+    }
+}
+#endif
+
+static void serve(WorkerConfig config, bool reuse_port, std::vector<StaticMount> mounts,
+                  ResponseCache* cache, AccessLog* log) {
+    // The bridge lives on this thread's loop: its sockets and timers are here
+    Bridge bridge(config);
+    bridge.start();
+    cppcorn::http::g_bridge = &bridge;
+
+    // Gates calls into this thread's bridge
+    auto limiter = admission(config);
+
+    // Per-thread, so its file cache needs no locking
+    std::unique_ptr<StaticFiles> static_files;
+#ifndef _WIN32
+    if (!mounts.empty()) static_files = std::make_unique<StaticFiles>(std::move(mounts));
+#endif
+
+    // Start HTTP Server
+    // CPPCORN_COALESCE=1: identical concurrent GETs share one worker call
+    std::unique_ptr<SingleFlight> coalescer;
+    if (const char* env = std::getenv("CPPCORN_COALESCE"); env && std::atoi(env) > 0) {
+        coalescer = std::make_unique<SingleFlight>();
+    }
+
+    // CPPCORN_METRICS_PATH: where the Prometheus scrape is served
+    // (default /__cppcorn/metrics; empty turns it off)
+    const char* metrics_env = std::getenv("CPPCORN_METRICS_PATH");
+    std::string metrics_path = metrics_env ? metrics_env : "/__cppcorn/metrics";
+
+    ConnectionOptions options;
+    options.timeouts = connection_timeouts();
+    options.static_files = static_files.get();
+    options.cache = cache;
+    options.coalescer = coalescer.get();
+    options.admission = limiter.get();
+    options.metrics_path = metrics_path;
+    options.access_log = log;
+    Server server("0.0.0.0", 8000, reuse_port, options);
+    // We need to keep the server task alive.
+    // In this simple model, we can just fire it if the loop runs indefinitely.
+    // However, `run()` is a coroutine, so we need to start it.
+    auto server_task = server.run();
+
+    EventLoop::instance().run();
+}
 
 int main() {
     std::printf("CppCorn: Initializing...\n");
     std::fflush(stdout);
 
     try {
-        EventLoop& loop = EventLoop::instance();
-        std::printf("CppCorn: EventLoop initialized.\n");
-        std::fflush(stdout);
-        
-        Bridge bridge;
-        bridge.listen();
-        std::printf("CppCorn: Bridge listening.\n");
-        std::fflush(stdout);
-
-        bridge.spawn_worker(); 
-        bridge.accept_worker(); 
-        
-        cppcorn::http::g_bridge = &bridge;
-        
-        // Start HTTP Server
-        Server server("0.0.0.0", 8000);
-        // We need to keep the server task alive. 
-        // In this simple model, we can just fire it if the loop runs indefinitely.
-        // However, `run()` is a coroutine, so we need to start it.
-        auto server_task = server.run();
-        
-        loop.run();
+#ifndef _WIN32
+        select_io_backend();
+        if (embedded_python()) {
+            const char* sub = std::getenv("CPPCORN_SUBINTERPRETERS");
+            Interpreter::initialize(sub && std::atoi(sub) > 0);
+        }
+#endif
+        int threads = loop_thread_count();
+        int workers = worker_count(threads);
+        std::vector<StaticMount> mounts;
+#ifndef _WIN32
+        mounts = static_mounts();
+#endif
+        auto cache = response_cache();
+        auto log = access_log();
+
+        if (threads == 1) {
+            serve(worker_config(0, 1, workers), false, std::move(mounts), cache.get(), log.get());
+            return 0;
+        }
+
+        fmt::print("Starting {} event loop threads with {} workers...\n", threads, workers);
+        std::vector<std::thread> loops;
+        for (int i = 0; i < threads; ++i) {
+            loops.emplace_back([config = worker_config(i, threads, workers), mounts, cache = cache.get(),
+                                log = log.get()] {
+                try {
+                    serve(config, true, mounts, cache, log);
+                } catch (const std::exception& e) {
+                    fmt::print("Loop Thread Error: {}\n", e.what());
+                }
+            });
+        }
+        for (auto& t : loops) t.join();
     } catch (const std::exception& e) {
         fmt::print("Critial Error: {}\n", e.what());
     }